@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+'use strict';
+
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const zlib = require('zlib');
+
+/**
+ * Image formats the synthetic corpus can be generated in. Each writer takes RGBA pixels and returns the encoded file.
+ */
+const gWriters = {
+    png: writePng,
+    bmp: writeBmp,
+    tga: writeTga,
+    ppm: writePpm,
+    svg: writeSvg,
+};
+
+let sCrcTable;
+
+/**
+ * Generate a synthetic image corpus in a temporary directory.
+ *
+ * Images are gradients with some noise, so the compressed formats do real work when decoding. The same options
+ * always produce the same files, which keeps runs comparable.
+ *
+ * @arg {Object} options
+ * @arg {int} options.count Number of files to generate.
+ * @arg {int} options.width Width of each image.
+ * @arg {int} options.height Height of each image.
+ * @arg {string[]} options.formats Formats to cycle through (see gWriters).
+ * @arg {string} [options.dir] Output directory. Defaults to a new directory in os.tmpdir().
+ * @returns {{dir: string, files: string[]}}
+ */
+function createCorpus(options) {
+    const dir = options.dir || fs.mkdtempSync(path.join(os.tmpdir(), 'pixels-please-bench-'));
+    const files = [];
+
+    options.formats.forEach(format => {
+        if (!(format in gWriters)) {
+            throw Error(`Unsupported corpus format: ${format}. Valid values: ${Object.keys(gWriters).join(', ')}`);
+        }
+    });
+
+    for (let i = 0; i < options.count; i++) {
+        const format = options.formats[i % options.formats.length];
+        const filename = path.join(dir, `${i}.${format}`);
+
+        fs.writeFileSync(filename, gWriters[format](createPixels(options.width, options.height, i), options.width, options.height));
+        files.push(filename);
+    }
+
+    return { dir, files };
+}
+
+/**
+ * Remove a corpus created by createCorpus().
+ *
+ * @arg {{dir: string, files: string[]}} corpus
+ */
+function removeCorpus(corpus) {
+    corpus.files.forEach(file => fs.unlinkSync(file));
+    fs.rmdirSync(corpus.dir);
+}
+
+function createPixels(width, height, seed) {
+    const pixels = Buffer.alloc(width*height*4);
+    let random = (seed + 1) * 2654435761 >>> 0;
+
+    for (let y = 0; y < height; y++) {
+        for (let x = 0; x < width; x++) {
+            const i = (y*width + x)*4;
+
+            random = (random * 1664525 + 1013904223) >>> 0;
+
+            pixels[i    ] = (x * 255 / width + (random & 0x0F)) & 0xFF;
+            pixels[i + 1] = (y * 255 / height + ((random >> 8) & 0x0F)) & 0xFF;
+            pixels[i + 2] = (seed * 37 + ((random >> 16) & 0x0F)) & 0xFF;
+            pixels[i + 3] = 0xFF;
+        }
+    }
+
+    return pixels;
+}
+
+function crc32(buffer) {
+    if (!sCrcTable) {
+        sCrcTable = new Int32Array(256);
+
+        for (let n = 0; n < 256; n++) {
+            let c = n;
+
+            for (let k = 0; k < 8; k++) {
+                c = (c & 1) ? (0xEDB88320 ^ (c >>> 1)) : (c >>> 1);
+            }
+
+            sCrcTable[n] = c;
+        }
+    }
+
+    let crc = -1;
+
+    for (let i = 0; i < buffer.length; i++) {
+        crc = sCrcTable[(crc ^ buffer[i]) & 0xFF] ^ (crc >>> 8);
+    }
+
+    return (crc ^ -1) >>> 0;
+}
+
+function pngChunk(type, data) {
+    const chunk = Buffer.alloc(data.length + 12);
+
+    chunk.writeUInt32BE(data.length, 0);
+    chunk.write(type, 4, 'ascii');
+    data.copy(chunk, 8);
+    chunk.writeUInt32BE(crc32(chunk.slice(4, data.length + 8)), data.length + 8);
+
+    return chunk;
+}
+
+function writePng(pixels, width, height) {
+    const ihdr = Buffer.alloc(13);
+    const scanlines = Buffer.alloc((width*4 + 1)*height);
+
+    ihdr.writeUInt32BE(width, 0);
+    ihdr.writeUInt32BE(height, 4);
+    ihdr[8] = 8; // bit depth
+    ihdr[9] = 6; // truecolor + alpha
+
+    for (let y = 0; y < height; y++) {
+        // filter type 0 (none) followed by the row
+        pixels.copy(scanlines, y*(width*4 + 1) + 1, y*width*4, (y + 1)*width*4);
+    }
+
+    return Buffer.concat([
+        Buffer.from([0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A]),
+        pngChunk('IHDR', ihdr),
+        pngChunk('IDAT', zlib.deflateSync(scanlines)),
+        pngChunk('IEND', Buffer.alloc(0)),
+    ]);
+}
+
+function writeBmp(pixels, width, height) {
+    const rowSize = (width*3 + 3) & ~3;
+    const file = Buffer.alloc(54 + rowSize*height);
+
+    file.write('BM', 0, 'ascii');
+    file.writeUInt32LE(file.length, 2);
+    file.writeUInt32LE(54, 10);
+    file.writeUInt32LE(40, 14);
+    file.writeInt32LE(width, 18);
+    file.writeInt32LE(height, 22);
+    file.writeUInt16LE(1, 26);
+    file.writeUInt16LE(24, 28);
+    file.writeUInt32LE(rowSize*height, 34);
+
+    for (let y = 0; y < height; y++) {
+        // bottom up, bgr
+        const row = 54 + (height - 1 - y)*rowSize;
+
+        for (let x = 0; x < width; x++) {
+            const i = (y*width + x)*4;
+
+            file[row + x*3    ] = pixels[i + 2];
+            file[row + x*3 + 1] = pixels[i + 1];
+            file[row + x*3 + 2] = pixels[i];
+        }
+    }
+
+    return file;
+}
+
+function writeTga(pixels, width, height) {
+    const file = Buffer.alloc(18 + width*height*4);
+
+    file[2] = 2; // uncompressed truecolor
+    file.writeUInt16LE(width, 12);
+    file.writeUInt16LE(height, 14);
+    file[16] = 32;
+    file[17] = 0x28; // top left origin, 8 alpha bits
+
+    for (let i = 0; i < width*height*4; i += 4) {
+        file[18 + i    ] = pixels[i + 2];
+        file[18 + i + 1] = pixels[i + 1];
+        file[18 + i + 2] = pixels[i];
+        file[18 + i + 3] = pixels[i + 3];
+    }
+
+    return file;
+}
+
+function writePpm(pixels, width, height) {
+    const header = Buffer.from(`P6\n${width} ${height}\n255\n`, 'ascii');
+    const body = Buffer.alloc(width*height*3);
+
+    for (let i = 0, j = 0; i < width*height*4; i += 4, j += 3) {
+        body[j    ] = pixels[i];
+        body[j + 1] = pixels[i + 1];
+        body[j + 2] = pixels[i + 2];
+    }
+
+    return Buffer.concat([header, body]);
+}
+
+function writeSvg(pixels, width, height) {
+    // Rasterization cost scales with the shape count and output size rather than pixel data, so the pixels only seed
+    // the colors.
+    const shapes = [];
+
+    for (let i = 0; i < 32; i++) {
+        const p = (i * 997 % (width*height))*4;
+        const color = `rgb(${pixels[p]},${pixels[p + 1]},${pixels[p + 2]})`;
+
+        shapes.push(`<circle cx="${(i * 31) % width}" cy="${(i * 17) % height}" r="${width/8}" fill="${color}"/>`);
+    }
+
+    return Buffer.from(`<svg xmlns="http://www.w3.org/2000/svg" width="${width}" height="${height}">${shapes.join('')}</svg>`);
+}
+
+module.exports = {
+    createCorpus,
+    removeCorpus,
+    formats: Object.keys(gWriters),
+};
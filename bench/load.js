@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+'use strict';
+
+/*
+ * Concurrent load benchmark.
+ *
+ * Drives toBuffer() / toHeader() against a synthetic corpus with a fixed number of requests in flight, for every
+ * combination of thread pool size and concurrency given on the command line. For each run, reports throughput,
+ * completion latency percentiles and how much the work delayed Node's event loop.
+ *
+ * Usage: node bench/load.js [--threads=1,4] [--concurrency=1,16,64] [--mode=buffer,header] [--count=2000]
+ *                           [--size=256x256] [--resize=64x64] [--formats=png,bmp,tga,ppm,svg] [--json]
+ */
+
+const { performance, monitorEventLoopDelay } = require('perf_hooks');
+const os = require('os');
+const Pipeline = require('../lib');
+const { createCorpus, removeCorpus, formats } = require('./corpus');
+
+const DEFAULTS = {
+    threads: [os.cpus().length],
+    concurrency: [1, 16, 64],
+    mode: ['buffer', 'header'],
+    count: 2000,
+    size: [256, 256],
+    resize: null,
+    formats,
+    json: false,
+};
+
+function parseArgs(argv) {
+    const options = Object.assign({}, DEFAULTS);
+    const ints = value => value.split(',').map(v => parseInt(v, 10));
+    const dimensions = value => value.split('x').map(v => parseInt(v, 10));
+
+    argv.forEach(arg => {
+        const [key, value] = arg.replace(/^--/, '').split('=');
+
+        switch (key) {
+            case 'threads':
+                options.threads = ints(value);
+                break;
+            case 'concurrency':
+                options.concurrency = ints(value);
+                break;
+            case 'mode':
+                options.mode = value.split(',');
+                break;
+            case 'count':
+                options.count = parseInt(value, 10);
+                break;
+            case 'size':
+                options.size = dimensions(value);
+                break;
+            case 'resize':
+                options.resize = dimensions(value);
+                break;
+            case 'formats':
+                options.formats = value.split(',');
+                break;
+            case 'json':
+                options.json = true;
+                break;
+            default:
+                throw Error(`Unknown option: ${arg}`);
+        }
+    });
+
+    return options;
+}
+
+function createRequest(source, options) {
+    const pipeline = Pipeline(source).bytes({format: 'rgba'});
+
+    if (options.resize) {
+        pipeline.resize(options.resize[0], options.resize[1]);
+    }
+
+    return pipeline;
+}
+
+function percentile(sorted, p) {
+    return sorted.length ? sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))] : 0;
+}
+
+/**
+ * Run one benchmark configuration: count requests with exactly `concurrency` of them in flight at any time.
+ */
+function run(files, mode, concurrency, options) {
+    const latencies = new Float64Array(options.count);
+    const histogram = monitorEventLoopDelay({ resolution: 1 });
+    let started = 0;
+    let completed = 0;
+    let errors = 0;
+    let startTime;
+
+    return new Promise(resolve => {
+        const next = () => {
+            if (completed === options.count) {
+                const elapsed = performance.now() - startTime;
+
+                histogram.disable();
+                latencies.sort();
+
+                resolve({
+                    mode,
+                    threads: Pipeline.threads,
+                    concurrency,
+                    count: options.count,
+                    errors,
+                    throughput: options.count / (elapsed / 1000),
+                    latencyP50: percentile(latencies, 0.50),
+                    latencyP99: percentile(latencies, 0.99),
+                    latencyMax: latencies[latencies.length - 1],
+                    loopDelayMean: histogram.mean / 1e6,
+                    loopDelayP99: histogram.percentile(99) / 1e6,
+                    loopDelayMax: histogram.max / 1e6,
+                });
+                return;
+            }
+
+            if (started === options.count) {
+                return;
+            }
+
+            const index = started++;
+            const pipeline = createRequest(files[index % files.length], options);
+            const begin = performance.now();
+            const done = () => {
+                latencies[index] = performance.now() - begin;
+                completed++;
+                next();
+            };
+
+            (mode === 'header' ? pipeline.toHeader() : pipeline.toBuffer())
+                .then(result => {
+                    result.release && result.release();
+                    done();
+                })
+                .catch(() => {
+                    errors++;
+                    done();
+                });
+        };
+
+        startTime = performance.now();
+        histogram.enable();
+
+        for (let i = 0; i < concurrency; i++) {
+            next();
+        }
+    });
+}
+
+function format(result) {
+    const ms = value => value.toFixed(2).padStart(9);
+
+    return [
+        result.mode.padEnd(7),
+        String(result.threads).padStart(7),
+        String(result.concurrency).padStart(11),
+        result.throughput.toFixed(0).padStart(10),
+        ms(result.latencyP50),
+        ms(result.latencyP99),
+        ms(result.latencyMax),
+        ms(result.loopDelayMean),
+        ms(result.loopDelayP99),
+        ms(result.loopDelayMax),
+        String(result.errors).padStart(6),
+    ].join(' ');
+}
+
+async function main() {
+    const options = parseArgs(process.argv.slice(2));
+    const corpus = createCorpus({
+        count: Math.min(options.count, 256),
+        width: options.size[0],
+        height: options.size[1],
+        formats: options.formats,
+    });
+    const results = [];
+
+    if (!options.json) {
+        console.log(`corpus: ${corpus.files.length} files, ${options.size.join('x')}, ${options.formats.join(',')}`
+            + (options.resize ? `, resize ${options.resize.join('x')}` : ''));
+        console.log('mode     threads concurrency     ops/s   p50(ms)   p99(ms)   max(ms) loop-mean  loop-p99  loop-max errors');
+    }
+
+    try {
+        for (const threads of options.threads) {
+            Pipeline.threads = threads;
+
+            for (const mode of options.mode) {
+                // warm up the file cache and thread pool
+                await run(corpus.files, mode, threads, Object.assign({}, options, { count: corpus.files.length }));
+
+                for (const concurrency of options.concurrency) {
+                    const result = await run(corpus.files, mode, concurrency, options);
+
+                    results.push(result);
+                    options.json || console.log(format(result));
+                }
+            }
+        }
+    } finally {
+        removeCorpus(corpus);
+    }
+
+    options.json && console.log(JSON.stringify(results, null, 2));
+}
+
+main().catch(e => {
+    console.error(e);
+    process.exitCode = 1;
+});
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+'use strict';
+
+/*
+ * Resize engine benchmark.
+ *
+ * Resizes a synthetic corpus with every combination of filter and resize engine given on the command line, one image
+ * at a time on the main thread, so the numbers are the cost of a single load. Uncompressed corpus formats keep the
+ * decode cost small next to the resize.
+ *
+ * Usage: node bench/resize.js [--filters=box,tent,gaussian] [--engines=float,fixed] [--count=200]
+ *                             [--size=1024x768] [--resize=256x192] [--formats=bmp,tga] [--json]
+ */
+
+const { performance } = require('perf_hooks');
+const Pipeline = require('../lib');
+const { createCorpus, removeCorpus } = require('./corpus');
+
+const DEFAULTS = {
+    filters: ['box', 'tent', 'gaussian'],
+    engines: ['float', 'fixed'],
+    count: 200,
+    size: [1024, 768],
+    resize: [256, 192],
+    formats: ['bmp', 'tga'],
+    json: false,
+};
+
+function parseArgs(argv) {
+    const options = Object.assign({}, DEFAULTS);
+    const dimensions = value => value.split('x').map(v => parseInt(v, 10));
+
+    argv.forEach(arg => {
+        const [key, value] = arg.replace(/^--/, '').split('=');
+
+        switch (key) {
+            case 'filters':
+                options.filters = value.split(',');
+                break;
+            case 'engines':
+                options.engines = value.split(',');
+                break;
+            case 'count':
+                options.count = parseInt(value, 10);
+                break;
+            case 'size':
+                options.size = dimensions(value);
+                break;
+            case 'resize':
+                options.resize = dimensions(value);
+                break;
+            case 'formats':
+                options.formats = value.split(',');
+                break;
+            case 'json':
+                options.json = true;
+                break;
+            default:
+                throw Error(`Unknown option: ${arg}`);
+        }
+    });
+
+    return options;
+}
+
+/**
+ * Run one benchmark configuration: count synchronous resizes, cycling through the corpus.
+ */
+function run(files, filter, engine, count, options) {
+    const begin = performance.now();
+
+    for (let i = 0; i < count; i++) {
+        const buffer = Pipeline(files[i % files.length])
+            .bytes({format: 'rgba'})
+            .filter(filter, {engine})
+            .resize(options.resize[0], options.resize[1])
+            .toBufferSync();
+
+        buffer.release && buffer.release();
+    }
+
+    const elapsed = performance.now() - begin;
+
+    return {
+        filter,
+        engine,
+        count,
+        throughput: count / (elapsed / 1000),
+        mean: elapsed / count,
+    };
+}
+
+function format(result, baseline) {
+    return [
+        result.filter.padEnd(9),
+        result.engine.padEnd(7),
+        result.throughput.toFixed(0).padStart(8),
+        result.mean.toFixed(2).padStart(9),
+        (baseline ? (result.throughput / baseline.throughput).toFixed(2) + 'x' : '').padStart(8),
+    ].join(' ');
+}
+
+function main() {
+    const options = parseArgs(process.argv.slice(2));
+    const corpus = createCorpus({
+        count: 16,
+        width: options.size[0],
+        height: options.size[1],
+        formats: options.formats,
+    });
+    const results = [];
+
+    if (!options.json) {
+        console.log(`corpus: ${corpus.files.length} files, ${options.size.join('x')}, ${options.formats.join(',')}, `
+            + `resize ${options.resize.join('x')}`);
+        console.log('filter    engine     ops/s  mean(ms) vs-first');
+    }
+
+    try {
+        for (const filter of options.filters) {
+            let baseline;
+
+            for (const engine of options.engines) {
+                // warm up the file cache and the filter tables
+                run(corpus.files, filter, engine, corpus.files.length, options);
+
+                const result = run(corpus.files, filter, engine, options.count, options);
+
+                baseline = baseline || result;
+                results.push(result);
+                options.json || console.log(format(result, baseline));
+            }
+        }
+    } finally {
+        removeCorpus(corpus);
+    }
+
+    options.json && console.log(JSON.stringify(results, null, 2));
+}
+
+main();
@@ -3,9 +3,9 @@
     {
       "target_name": "pixels-please",
       'include_dirs': [
-        "<!@(node -p \"require('napi-thread-safe-callback').include\")",
         "<!@(node -p \"require('node-addon-api').include\")",
         "deps"],
+      'defines': [ 'NAPI_VERSION=6' ],
       'cflags!': [ '-fno-exceptions', '-D_THREAD_SAFE' ],
       'cflags_cc!': [ '-fno-exceptions' ],
       'xcode_settings': {
@@ -21,6 +21,10 @@
       ],
       "sources": [
         "src/Threads.cc",
+        "src/Completion.cc",
+        "src/Addon.cc",
+        "src/Resample.cc",
+        "src/Atlas.cc",
         "src/Pipeline.cc",
         "src/Init.cc"
       ]
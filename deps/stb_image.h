@@ -446,6 +446,16 @@ STBIDEF void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert);
 // flip the image vertically, so the first pixel in the output array is the bottom left
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+// set the byte offsets of red, green, blue and alpha in 8-bit, 4 channel output, for loads
+// on the calling thread. the default is 0, 1, 2, 3 (RGBA).
+STBIDEF void stbi_set_channel_order_thread(int red, int green, int blue, int alpha);
+
+// decode only what rows top to bottom-1 of the image need, for loads on the calling thread. jpeg,
+// non-interlaced png, bmp and uncompressed truecolor tga stop after row bottom-1 and return an image
+// only bottom rows tall; jpeg, bmp and tga also leave the rows above top undefined. other formats
+// decode every row. the default, 0, 0, decodes every row. not for use with flip vertically on load.
+STBIDEF void stbi_set_row_range_thread(int top, int bottom);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -559,6 +569,18 @@ typedef unsigned char validate_uint32[sizeof(stbi__uint32)==4 ? 1 : -1];
 #define STBI_NOTUSED(v)  (void)sizeof(v)
 #endif
 
+#ifndef STBI_THREAD_LOCAL
+   #if defined(__cplusplus) && __cplusplus >= 201103L
+      #define STBI_THREAD_LOCAL       thread_local
+   #elif defined(_MSC_VER)
+      #define STBI_THREAD_LOCAL       __declspec(thread)
+   #elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+      #define STBI_THREAD_LOCAL       _Thread_local
+   #elif defined(__GNUC__)
+      #define STBI_THREAD_LOCAL       __thread
+   #endif
+#endif
+
 #ifdef _MSC_VER
 #define STBI_HAS_LROTL
 #endif
@@ -969,6 +991,55 @@ STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
     stbi__vertically_flip_on_load = flag_true_if_should_flip;
 }
 
+static STBI_THREAD_LOCAL stbi_uc stbi__channel_order[4] = { 0, 1, 2, 3 };
+// set by decoders that wrote their 4 channel output in stbi__channel_order themselves
+static STBI_THREAD_LOCAL int stbi__channel_order_applied;
+
+STBIDEF void stbi_set_channel_order_thread(int red, int green, int blue, int alpha)
+{
+   stbi__channel_order[0] = (stbi_uc) red;
+   stbi__channel_order[1] = (stbi_uc) green;
+   stbi__channel_order[2] = (stbi_uc) blue;
+   stbi__channel_order[3] = (stbi_uc) alpha;
+}
+
+static int stbi__channel_order_is_rgba(void)
+{
+   return stbi__channel_order[0] == 0 && stbi__channel_order[1] == 1 && stbi__channel_order[2] == 2 && stbi__channel_order[3] == 3;
+}
+
+static STBI_THREAD_LOCAL int stbi__row_top, stbi__row_bottom;
+
+STBIDEF void stbi_set_row_range_thread(int top, int bottom)
+{
+   stbi__row_top = top;
+   stbi__row_bottom = bottom;
+}
+
+// number of rows to decode of an image img_y rows tall
+static int stbi__rows_to_decode(int img_y)
+{
+   return (stbi__row_bottom > 0 && stbi__row_bottom < img_y) ? stbi__row_bottom : img_y;
+}
+
+// first row to decode of the rows rows being decoded
+static int stbi__first_row_to_decode(int rows)
+{
+   return stbi__row_top < 0 ? 0 : stbi__row_top > rows ? rows : stbi__row_top;
+}
+
+// move RGBA pixels to stbi__channel_order, in place
+static void stbi__reorder_channels(stbi_uc *data, stbi__uint32 count)
+{
+   stbi__uint32 i;
+   int r = stbi__channel_order[0], g = stbi__channel_order[1], b = stbi__channel_order[2], a = stbi__channel_order[3];
+
+   for (i=0; i < count; ++i, data += 4) {
+      stbi_uc p0 = data[0], p1 = data[1], p2 = data[2], p3 = data[3];
+      data[r] = p0, data[g] = p1, data[b] = p2, data[a] = p3;
+   }
+}
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
    memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1085,7 +1156,10 @@ static void stbi__vertical_flip_slices(void *image, int w, int h, int z, int byt
 static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x, int *y, int *comp, int req_comp)
 {
    stbi__result_info ri;
-   void *result = stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
+   void *result;
+
+   stbi__channel_order_applied = 0;
+   result = stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
 
    if (result == NULL)
       return NULL;
@@ -1098,6 +1172,10 @@ static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x,
 
    // @TODO: move stbi__convert_format to here
 
+   // decoders that did not write the channel order directly get one pass over the output
+   if (req_comp == 4 && !stbi__channel_order_applied && !stbi__channel_order_is_rgba())
+      stbi__reorder_channels((stbi_uc *) result, (stbi__uint32) *x * (stbi__uint32) *y);
+
    if (stbi__vertically_flip_on_load) {
       int channels = req_comp ? req_comp : *comp;
       stbi__vertical_flip(result, *x, *y, channels * sizeof(stbi_uc));
@@ -1520,6 +1598,7 @@ static unsigned char *stbi__convert_format(unsigned char *data, int img_n, int r
 {
    int i,j;
    unsigned char *good;
+   int r = stbi__channel_order[0], g = stbi__channel_order[1], b = stbi__channel_order[2], a = stbi__channel_order[3];
 
    if (req_comp == img_n) return data;
    STBI_ASSERT(req_comp >= 1 && req_comp <= 4);
@@ -1541,11 +1620,11 @@ static unsigned char *stbi__convert_format(unsigned char *data, int img_n, int r
       switch (STBI__COMBO(img_n, req_comp)) {
          STBI__CASE(1,2) { dest[0]=src[0], dest[1]=255;                                     } break;
          STBI__CASE(1,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
-         STBI__CASE(1,4) { dest[0]=dest[1]=dest[2]=src[0], dest[3]=255;                     } break;
+         STBI__CASE(1,4) { dest[r]=dest[g]=dest[b]=src[0], dest[a]=255;                     } break;
          STBI__CASE(2,1) { dest[0]=src[0];                                                  } break;
          STBI__CASE(2,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
-         STBI__CASE(2,4) { dest[0]=dest[1]=dest[2]=src[0], dest[3]=src[1];                  } break;
-         STBI__CASE(3,4) { dest[0]=src[0],dest[1]=src[1],dest[2]=src[2],dest[3]=255;        } break;
+         STBI__CASE(2,4) { dest[r]=dest[g]=dest[b]=src[0], dest[a]=src[1];                  } break;
+         STBI__CASE(3,4) { dest[r]=src[0],dest[g]=src[1],dest[b]=src[2],dest[a]=255;        } break;
          STBI__CASE(3,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
          STBI__CASE(3,2) { dest[0]=stbi__compute_y(src[0],src[1],src[2]), dest[1] = 255;    } break;
          STBI__CASE(4,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
@@ -1556,6 +1635,8 @@ static unsigned char *stbi__convert_format(unsigned char *data, int img_n, int r
       #undef STBI__CASE
    }
 
+   if (req_comp == 4) stbi__channel_order_applied = 1;
+
    STBI_FREE(data);
    return good;
 }
@@ -1744,6 +1825,7 @@ typedef struct
 
    int scan_n, order[4];
    int restart_interval, todo;
+   int rows_done;      // the scan stopped after the last row being decoded
 
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
@@ -2683,6 +2765,24 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+// rows of component n that the rows being decoded read, from top to bottom-1. upsampling also reads
+// the row above and below.
+static int stbi__jpeg_row_top(stbi__jpeg *z, int n)
+{
+   return stbi__first_row_to_decode(stbi__rows_to_decode(z->s->img_y)) * z->img_comp[n].v / z->img_v_max - 1;
+}
+
+static int stbi__jpeg_row_bottom(stbi__jpeg *z, int n)
+{
+   return (stbi__rows_to_decode(z->s->img_y) * z->img_comp[n].v + z->img_v_max - 1) / z->img_v_max + 1;
+}
+
+// whether the 8 rows of component n from row y on are read; the idct of other blocks is skipped
+static int stbi__jpeg_rows_needed(stbi__jpeg *z, int n, int y)
+{
+   return y + 8 > stbi__jpeg_row_top(z, n) && y < stbi__jpeg_row_bottom(z, n);
+}
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
    stbi__jpeg_reset(z);
@@ -2701,7 +2801,8 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               if (stbi__jpeg_rows_needed(z, n, j*8))
+                  z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2711,6 +2812,11 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                   stbi__jpeg_reset(z);
                }
             }
+            // the only scan of a greyscale image can stop once past the rows being decoded
+            if (z->s->img_n == 1 && (j+1) * 8 >= stbi__jpeg_row_bottom(z, n)) {
+               z->rows_done = 1;
+               return 1;
+            }
          }
          return 1;
       } else { // interleaved
@@ -2729,7 +2835,8 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                         int y2 = (j*z->img_comp[n].v + y)*8;
                         int ha = z->img_comp[n].ha;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+                        if (stbi__jpeg_rows_needed(z, n, y2))
+                           z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
                      }
                   }
                }
@@ -2741,6 +2848,17 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                   stbi__jpeg_reset(z);
                }
             }
+            // a scan of every component holds the whole image, so it can stop once past the rows
+            // being decoded
+            if (z->scan_n == z->s->img_n) {
+               for (k=0; k < z->scan_n; ++k)
+                  if ((j+1) * z->img_comp[z->order[k]].v * 8 < stbi__jpeg_row_bottom(z, z->order[k]))
+                     break;
+               if (k == z->scan_n) {
+                  z->rows_done = 1;
+                  return 1;
+               }
+            }
          }
          return 1;
       }
@@ -2825,6 +2943,7 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
          for (j=0; j < h; ++j) {
             for (i=0; i < w; ++i) {
                short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+               if (!stbi__jpeg_rows_needed(z, n, j*8)) continue;
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
                z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
             }
@@ -3122,12 +3241,14 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
       j->img_comp[m].raw_coeff = NULL;
    }
    j->restart_interval = 0;
+   j->rows_done = 0;
    if (!stbi__decode_jpeg_header(j, STBI__SCAN_load)) return 0;
    m = stbi__get_marker(j);
    while (!stbi__EOI(m)) {
       if (stbi__SOS(m)) {
          if (!stbi__process_scan_header(j)) return 0;
          if (!stbi__parse_entropy_coded_data(j)) return 0;
+         if (j->rows_done) return 1;
          if (j->marker == STBI__MARKER_none ) {
             // handle 0s at the end of image data from IP Kamera 9060
             while (!stbi__at_eof(j->s)) {
@@ -3595,6 +3716,8 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    {
       int k;
       unsigned int i,j;
+      unsigned int rows = stbi__rows_to_decode(z->s->img_y);
+      unsigned int first = stbi__first_row_to_decode(rows);
       stbi_uc *output;
       stbi_uc *coutput[4];
 
@@ -3623,19 +3746,20 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
       }
 
       // can't error after this so, this is safe
-      output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
+      output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, rows, 1);
       if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
 
       // now go ahead and resample
-      for (j=0; j < z->s->img_y; ++j) {
+      for (j=0; j < rows; ++j) {
          stbi_uc *out = output + n * z->s->img_x * j;
          for (k=0; k < decode_n; ++k) {
             stbi__resample *r = &res_comp[k];
             int y_bot = r->ystep >= (r->vs >> 1);
-            coutput[k] = r->resample(z->img_comp[k].linebuf,
-                                     y_bot ? r->line1 : r->line0,
-                                     y_bot ? r->line0 : r->line1,
-                                     r->w_lores, r->hs);
+            if (j >= first)
+               coutput[k] = r->resample(z->img_comp[k].linebuf,
+                                        y_bot ? r->line1 : r->line0,
+                                        y_bot ? r->line0 : r->line1,
+                                        r->w_lores, r->hs);
             if (++r->ystep >= r->vs) {
                r->ystep = 0;
                r->line0 = r->line1;
@@ -3643,6 +3767,8 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
                   r->line1 += z->img_comp[k].w2;
             }
          }
+         // rows above the first being decoded only move the resamplers along
+         if (j < first) continue;
          if (n >= 3) {
             stbi_uc *y = coutput[0];
             if (z->s->img_n == 3) {
@@ -3720,10 +3846,14 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
                   for (i=0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
             }
          }
+         // reorder each row while it is still in cache
+         if (n == 4 && !stbi__channel_order_is_rgba())
+            stbi__reorder_channels(output + n * z->s->img_x * j, z->s->img_x);
       }
+      if (n == 4) stbi__channel_order_applied = 1;
       stbi__cleanup_jpeg(z);
       *out_x = z->s->img_x;
-      *out_y = z->s->img_y;
+      *out_y = rows;
       if (comp) *comp = z->s->img_n >= 3 ? 3 : 1; // report original components, not output
       return output;
    }
@@ -3881,6 +4011,8 @@ typedef struct
    char *zout_start;
    char *zout_end;
    int   z_expandable;
+   int   z_truncate;   // a full output buffer ends decoding instead of failing it
+   int   z_truncated;  // decoding ended that way
 
    stbi__zhuffman z_length, z_distance;
 } stbi__zbuf;
@@ -3947,6 +4079,10 @@ static int stbi__zexpand(stbi__zbuf *z, char *zout, int n)  // need to make room
    char *q;
    int cur, limit, old_limit;
    z->zout = zout;
+   if (!z->z_expandable && z->z_truncate) {
+      z->z_truncated = 1;
+      return 0;
+   }
    if (!z->z_expandable) return stbi__err("output buffer limit","Corrupt PNG");
    cur   = (int) (z->zout     - z->zout_start);
    limit = old_limit = (int) (z->zout_end - z->zout_start);
@@ -4087,6 +4223,14 @@ static int stbi__parse_uncompressed_block(stbi__zbuf *a)
    nlen = header[3] * 256 + header[2];
    if (nlen != (len ^ 0xffff)) return stbi__err("zlib corrupt","Corrupt PNG");
    if (a->zbuffer + len > a->zbuffer_end) return stbi__err("read past buffer","Corrupt PNG");
+   if (a->zout + len > a->zout_end && a->z_truncate && !a->z_expandable) {
+      // keep the part of the block that fits
+      len = (int) (a->zout_end - a->zout);
+      memcpy(a->zout, a->zbuffer, len);
+      a->zout += len;
+      a->z_truncated = 1;
+      return 0;
+   }
    if (a->zout + len > a->zout_end)
       if (!stbi__zexpand(a, a->zout, len)) return 0;
    memcpy(a->zout, a->zbuffer, len);
@@ -4171,10 +4315,35 @@ static int stbi__do_zlib(stbi__zbuf *a, char *obuf, int olen, int exp, int parse
    a->zout       = obuf;
    a->zout_end   = obuf + olen;
    a->z_expandable = exp;
+   a->z_truncate = a->z_truncated = 0;
 
    return stbi__parse_zlib(a, parse_header);
 }
 
+// inflates the first len bytes of the stream, or all of it if it is shorter
+static char *stbi__zlib_decode_malloc_prefix(const char *buffer, int len, int prefix_len, int *outlen, int parse_header)
+{
+   stbi__zbuf a;
+   // room past the prefix for the longest match, so decoding only stops once the whole prefix is written
+   int olen = prefix_len + 258;
+   char *p = (char *) stbi__malloc(olen);
+   if (p == NULL) return NULL;
+   a.zbuffer = (stbi_uc *) buffer;
+   a.zbuffer_end = (stbi_uc *) buffer + len;
+   a.zout_start = a.zout = p;
+   a.zout_end = p + olen;
+   a.z_expandable = 0;
+   a.z_truncate = 1;
+   a.z_truncated = 0;
+   if (stbi__parse_zlib(&a, parse_header) || a.z_truncated) {
+      if (outlen) *outlen = (int) (a.zout - a.zout_start);
+      return a.zout_start;
+   } else {
+      STBI_FREE(a.zout_start);
+      return NULL;
+   }
+}
+
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen)
 {
    stbi__zbuf a;
@@ -4843,10 +5012,18 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
             if (first) return stbi__err("first not IHDR", "Corrupt PNG");
             if (scan != STBI__SCAN_load) return 1;
             if (z->idata == NULL) return stbi__err("no IDAT","Corrupt PNG");
+            // the rows after the last one being decoded are neither inflated nor unfiltered
+            if (!interlace && (int) s->img_y > stbi__rows_to_decode(s->img_y)) {
+               s->img_y = stbi__rows_to_decode(s->img_y);
+               bpl = (s->img_x * z->depth + 7) / 8;
+               raw_len = bpl * s->img_y * s->img_n + s->img_y;
+               z->expanded = (stbi_uc *) stbi__zlib_decode_malloc_prefix((char *) z->idata, ioff, raw_len, (int *) &raw_len, !is_iphone);
+            } else {
             // initial guess for decoded data size to avoid unnecessary reallocs
             bpl = (s->img_x * z->depth + 7) / 8; // bytes per line, per component
             raw_len = bpl * s->img_y * s->img_n /* pixels */ + s->img_y /* filter mode per row */;
             z->expanded = (stbi_uc *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, raw_len, (int *) &raw_len, !is_iphone);
+            }
             if (z->expanded == NULL) return 0; // zlib should set error
             STBI_FREE(z->idata); z->idata = NULL;
             if ((req_comp == s->img_n+1 && req_comp != 3 && !pal_img_n) || has_trans)
@@ -4868,6 +5045,11 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
                s->img_n = pal_img_n; // record the actual colors we had
                s->img_out_n = pal_img_n;
                if (req_comp >= 3) s->img_out_n = req_comp;
+               if (req_comp == 4) {
+                  // reorder the palette instead of every pixel
+                  stbi__reorder_channels(palette, pal_len);
+                  stbi__channel_order_applied = 1;
+               }
                if (!stbi__expand_png_palette(z, palette, pal_len, s->img_out_n))
                   return 0;
             } else if (has_trans) {
@@ -5146,7 +5328,7 @@ static void *stbi__bmp_load(stbi__context *s, int *x, int *y, int *comp, int req
    unsigned int mr=0,mg=0,mb=0,ma=0, all_a;
    stbi_uc pal[256][4];
    int psize=0,i,j,width;
-   int flip_vertically, pad, target;
+   int flip_vertically, pad, target, rows, first, row_bytes;
    stbi__bmp_data info;
    STBI_NOTUSED(ri);
 
@@ -5181,7 +5363,11 @@ static void *stbi__bmp_load(stbi__context *s, int *x, int *y, int *comp, int req
    if (!stbi__mad3sizes_valid(target, s->img_x, s->img_y, 0))
       return stbi__errpuc("too large", "Corrupt BMP");
 
-   out = (stbi_uc *) stbi__malloc_mad3(target, s->img_x, s->img_y, 0);
+   // telling a missing alpha channel from a transparent image takes every row
+   rows = all_a ? stbi__rows_to_decode(s->img_y) : (int) s->img_y;
+   first = all_a ? stbi__first_row_to_decode(rows) : 0;
+
+   out = (stbi_uc *) stbi__malloc_mad3(target, s->img_x, rows, 0);
    if (!out) return stbi__errpuc("outofmem", "Out of memory");
    if (info.bpp < 16) {
       int z=0;
@@ -5199,15 +5385,24 @@ static void *stbi__bmp_load(stbi__context *s, int *x, int *y, int *comp, int req
       else if (info.bpp == 8) width = s->img_x;
       else { STBI_FREE(out); return stbi__errpuc("bad bpp", "Corrupt BMP"); }
       pad = (-width)&3;
+      row_bytes = width + pad;
       if (info.bpp == 1) {
          for (j=0; j < (int) s->img_y; ++j) {
-            int bit_offset = 7, v = stbi__get8(s);
+            int bit_offset = 7, v, r = flip_vertically ? s->img_y-1-j : j;
+            if (r < first || r >= rows) {
+               if (flip_vertically ? r < first : r >= rows) break;
+               stbi__skip(s, row_bytes);
+               continue;
+            }
+            z = r*s->img_x*target;
+            v = stbi__get8(s);
             for (i=0; i < (int) s->img_x; ++i) {
                int color = (v>>bit_offset)&0x1;
                out[z++] = pal[color][0];
                out[z++] = pal[color][1];
                out[z++] = pal[color][2];
-               if((--bit_offset) < 0) {
+               // the byte after the last pixel belongs to the padding
+               if((--bit_offset) < 0 && i+1 < (int) s->img_x) {
                   bit_offset = 7;
                   v = stbi__get8(s);
                }
@@ -5216,6 +5411,13 @@ static void *stbi__bmp_load(stbi__context *s, int *x, int *y, int *comp, int req
          }
       } else {
          for (j=0; j < (int) s->img_y; ++j) {
+            int r = flip_vertically ? s->img_y-1-j : j;
+            if (r < first || r >= rows) {
+               if (flip_vertically ? r < first : r >= rows) break;
+               stbi__skip(s, row_bytes);
+               continue;
+            }
+            z = r*s->img_x*target;
             for (i=0; i < (int) s->img_x; i += 2) {
                int v=stbi__get8(s),v2=0;
                if (info.bpp == 4) {
@@ -5245,6 +5447,7 @@ static void *stbi__bmp_load(stbi__context *s, int *x, int *y, int *comp, int req
       else if (info.bpp == 16) width = 2*s->img_x;
       else /* bpp = 32 and pad = 0 */ width=0;
       pad = (-width) & 3;
+      row_bytes = (info.bpp >> 3) * s->img_x + pad;
       if (info.bpp == 24) {
          easy = 1;
       } else if (info.bpp == 32) {
@@ -5260,6 +5463,13 @@ static void *stbi__bmp_load(stbi__context *s, int *x, int *y, int *comp, int req
          ashift = stbi__high_bit(ma)-7; acount = stbi__bitcount(ma);
       }
       for (j=0; j < (int) s->img_y; ++j) {
+         int r = flip_vertically ? s->img_y-1-j : j;
+         if (r < first || r >= rows) {
+            if (flip_vertically ? r < first : r >= rows) break;
+            stbi__skip(s, row_bytes);
+            continue;
+         }
+         z = r*s->img_x*target;
          if (easy) {
             for (i=0; i < (int) s->img_x; ++i) {
                unsigned char a;
@@ -5293,16 +5503,8 @@ static void *stbi__bmp_load(stbi__context *s, int *x, int *y, int *comp, int req
       for (i=4*s->img_x*s->img_y-1; i >= 0; i -= 4)
          out[i] = 255;
 
-   if (flip_vertically) {
-      stbi_uc t;
-      for (j=0; j < (int) s->img_y>>1; ++j) {
-         stbi_uc *p1 = out +      j     *s->img_x*target;
-         stbi_uc *p2 = out + (s->img_y-1-j)*s->img_x*target;
-         for (i=0; i < (int) s->img_x*target; ++i) {
-            t = p1[i], p1[i] = p2[i], p2[i] = t;
-         }
-      }
-   }
+   // rows were written where they belong, bottom-up files included
+   s->img_y = rows;
 
    if (req_comp && req_comp != target) {
       out = stbi__convert_format(out, target, req_comp, s->img_x, s->img_y);
@@ -5473,7 +5675,7 @@ static void *stbi__tga_load(stbi__context *s, int *x, int *y, int *comp, int req
    //   image data
    unsigned char *tga_data;
    unsigned char *tga_palette = NULL;
-   int i, j;
+   int i, j, rows, first;
    unsigned char raw_data[4] = {0};
    int RLE_count = 0;
    int RLE_repeating = 0;
@@ -5495,15 +5697,24 @@ static void *stbi__tga_load(stbi__context *s, int *x, int *y, int *comp, int req
    if(!tga_comp) // shouldn't really happen, stbi__tga_test() should have ensured basic consistency
       return stbi__errpuc("bad format", "Can't find out TGA pixelformat");
 
+   if (!stbi__mad3sizes_valid(tga_width, tga_height, tga_comp, 0))
+      return stbi__errpuc("too large", "Corrupt TGA");
+
+   // only rows of fixed size can be skipped
+   if ( !tga_indexed && !tga_is_RLE && !tga_rgb16 ) {
+      rows = stbi__rows_to_decode(tga_height);
+      first = stbi__first_row_to_decode(rows);
+   } else {
+      rows = tga_height;
+      first = 0;
+   }
+
    //   tga info
    *x = tga_width;
-   *y = tga_height;
+   *y = rows;
    if (comp) *comp = tga_comp;
 
-   if (!stbi__mad3sizes_valid(tga_width, tga_height, tga_comp, 0))
-      return stbi__errpuc("too large", "Corrupt TGA");
-
-   tga_data = (unsigned char*)stbi__malloc_mad3(tga_width, tga_height, tga_comp, 0);
+   tga_data = (unsigned char*)stbi__malloc_mad3(tga_width, rows, tga_comp, 0);
    if (!tga_data) return stbi__errpuc("outofmem", "Out of memory");
 
    // skip to the data's starting position (offset usually = 0)
@@ -5513,8 +5724,14 @@ static void *stbi__tga_load(stbi__context *s, int *x, int *y, int *comp, int req
       for (i=0; i < tga_height; ++i) {
          int row = tga_inverted ? tga_height -i - 1 : i;
          stbi_uc *tga_row = tga_data + row*tga_width*tga_comp;
+         if (row < first || row >= rows) {
+            if (tga_inverted ? row < first : row >= rows) break;
+            stbi__skip(s, tga_width * tga_comp);
+            continue;
+         }
          stbi__getn(s, tga_row, tga_width * tga_comp);
       }
+      tga_height = rows;
    } else  {
       //   do I need to load a palette?
       if ( tga_indexed)
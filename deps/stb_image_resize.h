@@ -400,6 +400,12 @@ STBIRDEF int stbir_resize_region(  const void *input_pixels , int input_w , int
 #define STBIR_FREE(ptr,c)    ((void)(c), free(ptr))
 #endif
 
+// Lets the includer supply the contributor and coefficient tables, e.g. from a cache. The replacement has the
+// signature of stbir__calculate_filters() and must fill the tables exactly as it would.
+#ifndef STBIR_CALCULATE_FILTERS
+#define STBIR_CALCULATE_FILTERS stbir__calculate_filters
+#endif
+
 #ifndef _MSC_VER
 #ifdef __cplusplus
 #define stbir__inline inline
@@ -2395,8 +2401,8 @@ static int stbir__resize_allocated(stbir__info *info,
     // This signals that the ring buffer is empty
     info->ring_buffer_begin_index = -1;
 
-    stbir__calculate_filters(info->horizontal_contributors, info->horizontal_coefficients, info->horizontal_filter, info->horizontal_scale, info->horizontal_shift, info->input_w, info->output_w);
-    stbir__calculate_filters(info->vertical_contributors, info->vertical_coefficients, info->vertical_filter, info->vertical_scale, info->vertical_shift, info->input_h, info->output_h);
+    STBIR_CALCULATE_FILTERS(info->horizontal_contributors, info->horizontal_coefficients, info->horizontal_filter, info->horizontal_scale, info->horizontal_shift, info->input_w, info->output_w);
+    STBIR_CALCULATE_FILTERS(info->vertical_contributors, info->vertical_coefficients, info->vertical_filter, info->vertical_scale, info->vertical_shift, info->input_h, info->output_h);
 
     STBIR_PROGRESS_REPORT(0);
 
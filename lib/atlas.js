@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+'use strict';
+
+const is = require('./is');
+const { checkPixelFormat } = require('./format');
+const native = require('bindings')('pixels-please');
+
+/**
+ * Texture atlas options.
+ *
+ * @typedef {Object} AtlasOptions
+ * @property {int} [maxSize=2048] Largest width and height of a page. Pages are cropped to the images on them.
+ * @property {int} [padding=0] Transparent pixels between images.
+ * @property {boolean} [trim=false] Drop transparent rows and columns around each image before packing.
+ * @property {PixelFormat} [format='keep'] Pixel format of the pages.
+ */
+
+/**
+ * Where an image was drawn in an atlas. u0, v0, u1 and v1 are the texture coordinates of the frame's corners, from 0
+ * to 1 across the page. A trimmed image also has the offset of the kept pixels in the image, so sprites can be drawn
+ * where they were before trimming.
+ *
+ * @typedef {Object} AtlasFrame
+ * @property {int} page Index of the page in pages.
+ * @property {int} x
+ * @property {int} y
+ * @property {int} width
+ * @property {int} height
+ * @property {number} u0
+ * @property {number} v0
+ * @property {number} u1
+ * @property {number} v1
+ * @property {int} trimX Left of the kept pixels in the image. 0 unless trimmed.
+ * @property {int} trimY Top of the kept pixels in the image. 0 unless trimmed.
+ * @property {int} sourceWidth Width of the image before trimming.
+ * @property {int} sourceHeight Height of the image before trimming.
+ */
+
+/**
+ * Texture atlas pages and the frame of each image.
+ *
+ * @typedef {Object} Atlas
+ * @property {Buffer[]} pages Page pixels. Each has a header of type Header.
+ * @property {AtlasFrame[]} frames One frame for each source, in the order of sources.
+ */
+
+/**
+ * Pack many images onto the pages of a texture atlas. Every image is decoded on the thread pool at the same time. Once
+ * the last one is done, the images are packed with a skyline packer, tallest first, and drawn straight into the pages,
+ * so there is no per image copy in javascript. The atlas fails if any image fails to load or is larger than a page.
+ *
+ * Sources can be filenames or pipelines configured for bytes output, to resize or crop images before packing. The
+ * pixel format of the pipelines is ignored in favour of options.format.
+ *
+ * @arg {Array<String|Pipeline>} sources Images to pack.
+ * @arg {AtlasOptions} [options]
+ * @returns {Promise<Atlas>}
+ * @throws {Error} when sources or options are invalid
+ * @static
+ * @method Pipeline.atlas
+ */
+function atlas(sources, options) {
+    return native.loadAtlas(getAtlasRequests(this, sources), getAtlasOptions(options));
+}
+
+/**
+ * Pack many images onto the pages of a texture atlas. This operation occurs synchronously on Node's main thread, one
+ * image at a time.
+ *
+ * @arg {Array<String|Pipeline>} sources Images to pack.
+ * @arg {AtlasOptions} [options]
+ * @returns {Atlas}
+ * @throws {Error} when sources or options are invalid, or an image fails to load
+ * @static
+ * @method Pipeline.atlasSync
+ */
+function atlasSync(sources, options) {
+    return native.loadAtlasSync(getAtlasRequests(this, sources), getAtlasOptions(options));
+}
+
+function getAtlasRequests(Pixels, sources) {
+    if (!Array.isArray(sources) || sources.length === 0) {
+        throw Error(`Invalid sources: ${sources}. Should be a non-empty array.`);
+    }
+
+    return sources.map(source => {
+        const pipeline = is.string(source) ? Pixels(source) : source;
+
+        if (!(pipeline instanceof Pixels)) {
+            throw Error(`Invalid atlas source: ${source}.`);
+        }
+
+        const request = pipeline.request;
+
+        if (request.output !== 'bytes' || request.outputOptions.shared !== false) {
+            throw Error('Atlas sources only support bytes output without shared memory.');
+        }
+
+        // Images are packed as decoded. The pages are converted to the atlas format.
+        return Object.assign({}, request, { outputOptions: Object.assign({}, request.outputOptions, { format: 'keep' }) });
+    });
+}
+
+function getAtlasOptions(options) {
+    const { maxSize = 2048, padding = 0, trim = false, format = 'keep' } = options || {};
+
+    if (!is.int(maxSize) || maxSize <= 0) {
+        throw Error(`Invalid maxSize option: ${maxSize}. Should be a positive integer.`);
+    }
+
+    if (!is.int(padding) || padding < 0) {
+        throw Error(`Invalid padding option: ${padding}. Should be a non-negative integer.`);
+    }
+
+    if (typeof trim !== 'boolean') {
+        throw Error(`Invalid trim option: ${trim}. Should be a boolean.`);
+    }
+
+    checkPixelFormat(format);
+
+    return { maxSize, padding, trim, format };
+}
+
+module.exports = (Pixels) => {
+    Pixels.atlas = atlas;
+    Pixels.atlasSync = atlasSync;
+};
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+'use strict';
+
+const native = require('bindings')('pixels-please');
+
+/**
+ * Output several images of the same output size to one Buffer, one after the other like the layers of a texture array.
+ * Each pipeline is processed with its own settings. The batch fails if any image fails to load or if the output sizes
+ * differ. All image processing occurs in a background thread that will not block Node's main loop.
+ *
+ * The returned buffer has an extended field header of type Header, with offsets set to the byte offset of each image
+ * in the order of pipelines.
+ *
+ * @arg {Pipeline[]} pipelines Pipelines configured for bytes output, all with the same pixel format.
+ * @returns {Promise<Buffer>}
+ * @throws {Error} when pipelines are invalid
+ * @static
+ * @method Pipeline.toBatch
+ */
+function toBatch(pipelines) {
+    return native.loadPipeline(getBatchRequest(this, pipelines), false);
+}
+
+/**
+ * Output several images of the same output size to one Buffer. This operation occurs synchronously on Node's main
+ * thread.
+ *
+ * @arg {Pipeline[]} pipelines Pipelines configured for bytes output, all with the same pixel format.
+ * @returns {Buffer}
+ * @throws {Error} when pipelines are invalid or an image fails to load
+ * @static
+ * @method Pipeline.toBatchSync
+ */
+function toBatchSync(pipelines) {
+    return native.loadPipelineSync(getBatchRequest(this, pipelines), false);
+}
+
+function getBatchRequest(Pixels, pipelines) {
+    if (!Array.isArray(pipelines) || pipelines.length === 0) {
+        throw Error(`Invalid pipelines: ${pipelines}. Should be a non-empty array.`);
+    }
+
+    const requests = pipelines.map(pipeline => {
+        if (!(pipeline instanceof Pixels)) {
+            throw Error(`Invalid pipeline: ${pipeline}.`);
+        }
+
+        const request = pipeline.request;
+
+        if (request.output !== 'bytes' || request.outputOptions.shared !== false) {
+            throw Error('Batches only support bytes output without shared memory.');
+        }
+
+        if (request.outputOptions.format !== pipelines[0].request.outputOptions.format) {
+            throw Error('Batch images must all have the same pixel format.');
+        }
+
+        return request;
+    });
+
+    return Object.assign({}, requests[0], { batch: requests });
+}
+
+module.exports = (Pixels) => {
+    Pixels.toBatch = toBatch;
+    Pixels.toBatchSync = toBatchSync;
+};
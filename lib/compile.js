@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+'use strict';
+
+const is = require('./is');
+const { getTarget } = require('./output');
+const native = require('bindings')('pixels-please');
+
+/**
+ * Pipeline methods that can be compiled.
+ */
+const gSteps = new Set(['bytes', 'tensor', 'crop', 'resize', 'contain', 'fit', 'cover', 'pad', 'filter', 'ignoreAspectRatio']);
+
+/**
+ * Pipeline settings to compile. Each key names a Pipeline method and its value holds the arguments to call it with: an
+ * array of arguments, true for no arguments or any other value as the only argument.
+ *
+ * @example
+ * Pipeline.compile({ bytes: {format: 'rgba'}, cover: 'north', resize: [128, 128], filter: 'box' })
+ *
+ * @typedef {Object} CompileOptions
+ */
+
+/**
+ * Pipeline settings resolved once on the native side, to be applied to any number of sources. Loading through a
+ * compiled pipeline skips reading the settings from javascript, and parsing them, for every image.
+ *
+ * @class
+ */
+function CompiledPipeline(request) {
+    this.request = request;
+    this.handle = native.compilePipeline(request);
+}
+
+/**
+ * Output an image to a Buffer, as Pipeline#toBuffer would for a pipeline with the compiled settings.
+ *
+ * @arg {String} source Image filename to load.
+ * @arg {OutputOptions} [options]
+ * @returns {Promise<Buffer|Uint8Array>}
+ * @throws {Error} when source or options are invalid
+ * @method CompiledPipeline#run
+ */
+CompiledPipeline.prototype.run = function (source, options) {
+    checkSource(source);
+
+    return native.loadPipeline(this.handle, false, getTarget(this.request, options), undefined, source);
+};
+
+/**
+ * Output an image to a Buffer. This operation occurs synchronously on Node's main thread.
+ *
+ * @arg {String} source Image filename to load.
+ * @arg {OutputOptions} [options]
+ * @returns {Buffer|Uint8Array}
+ * @throws {Error} when source or options are invalid, or the image fails to load
+ * @method CompiledPipeline#runSync
+ */
+CompiledPipeline.prototype.runSync = function (source, options) {
+    checkSource(source);
+
+    return native.loadPipelineSync(this.handle, false, getTarget(this.request, options), undefined, source);
+};
+
+/**
+ * Output many images to Buffers with a single call into the native module. Every source is queued on the thread pool
+ * at once and the returned promise settles when the last one is done.
+ *
+ * A source that fails to load does not reject the promise. Its result is the Error instead. Each result has an index
+ * property pointing into sources, in its header for buffers and on the Error itself for failures.
+ *
+ * Shared output creates a SharedArrayBuffer for each source. Pipelines compiled to write to a given SharedArrayBuffer
+ * can only be run one source at a time.
+ *
+ * @arg {String[]} sources Image filenames to load.
+ * @arg {Object} [options]
+ * @arg {('input'|'completion')} [options.order='input'] Order of the results: that of sources, or that in which the
+ * loads finished.
+ * @returns {Promise<Array<Buffer|Uint8Array|Error>>}
+ * @throws {Error} when sources or options are invalid, or the pipeline outputs to a given SharedArrayBuffer
+ * @method CompiledPipeline#runAll
+ */
+CompiledPipeline.prototype.runAll = function (sources, options) {
+    const { order = 'input' } = options || {};
+
+    if (!Array.isArray(sources)) {
+        throw Error(`Invalid sources: ${sources}. Should be an array.`);
+    }
+
+    if (order !== 'input' && order !== 'completion') {
+        throw Error(`Invalid order option: ${order}. Valid values: input, completion`);
+    }
+
+    if (this.request.outputOptions.shared instanceof SharedArrayBuffer) {
+        throw Error('Output to a given SharedArrayBuffer is not supported for runAll. Use shared: true or run().');
+    }
+
+    sources.forEach(checkSource);
+
+    return native.loadPipelines(this.handle, sources, order === 'input');
+};
+
+/**
+ * Compile pipeline settings for reuse across many sources.
+ *
+ * @arg {CompileOptions} options
+ * @returns {CompiledPipeline}
+ * @throws {Error} when options are invalid
+ * @static
+ * @method Pipeline.compile
+ */
+function compile(options) {
+    // The source of the template pipeline is never loaded. Each run supplies its own.
+    const pipeline = this('compiled');
+
+    Object.keys(options || {}).forEach(step => {
+        const args = options[step];
+
+        if (!gSteps.has(step)) {
+            throw Error(`Invalid compile option: ${step}. Valid values: ${Array.from(gSteps).join(', ')}`);
+        }
+
+        pipeline[step](...(Array.isArray(args) ? args : (args === true ? [] : [args])));
+    });
+
+    return new CompiledPipeline(pipeline.request);
+}
+
+function checkSource(source) {
+    if (!source || !is.string(source)) {
+        throw Error('Invalid image source: ' + source);
+    }
+}
+
+module.exports = (Pixels) => {
+    Pixels.compile = compile;
+};
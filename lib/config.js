@@ -28,6 +28,9 @@ module.exports = (Pixels) =>  {
      * Gets or sets the internal image processing thread pool size. By default, the pool size is equal to the
      * number of cpu cores on the system. Setting threads to 0 will reset the pool size to the default.
      *
+     * The pool is shared by the main thread and all worker threads that load this module, so setting the size from
+     * any of them affects all of them.
+     *
      * @static
      * @name Pipeline.threads
      * @throws {Error} when setting a value other than a positive integer
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+'use strict';
+
+const is = require('./is');
+
+/**
+ * Crop the source image to a region before it is resized.
+ *
+ * Only the region is resized or copied to the output. SVG sources rasterize the region alone. Raster sources are
+ * decoded down to the last row of the region and no further, and the region is read from the decoded rows in place:
+ *
+ * - JPEG skips the IDCT and color conversion of the rows above the region, though it still reads their data.
+ * - Non-interlaced PNG still inflates and unfilters the rows above the region, as each row is filtered against the
+ * one before it.
+ * - BMP and uncompressed, non-indexed TGA skip the rows above the region without decoding them. 32-bit BMPs that
+ * may lack an alpha channel decode every row, as telling that takes all of them.
+ *
+ * Other sources, such as GIF, PSD, HDR, PNM, interlaced PNG and RLE or indexed TGA, are decoded in full.
+ *
+ * The region must be inside the source image, or the load fails.
+ *
+ * @arg {int} x Left edge of the region, in source image pixels.
+ * @arg {int} y Top edge of the region, in source image pixels.
+ * @arg {int} width Width of the region.
+ * @arg {int} height Height of the region.
+ * @returns {Pipeline}
+ * @method Pipeline#crop
+ */
+function crop(x, y, width, height) {
+    if (!is.int(x) || x < 0) {
+        throw Error(`Invalid crop x of ${x}. Should be a non-negative integer.`);
+    }
+
+    if (!is.int(y) || y < 0) {
+        throw Error(`Invalid crop y of ${y}. Should be a non-negative integer.`);
+    }
+
+    if (!is.int(width) || width <= 0) {
+        throw Error(`Invalid crop width of ${width}. Should be a positive integer.`);
+    }
+
+    if (!is.int(height) || height <= 0) {
+        throw Error(`Invalid crop height of ${height}. Should be a positive integer.`);
+    }
+
+    this.request.cropX = x;
+    this.request.cropY = y;
+    this.request.cropWidth = width;
+    this.request.cropHeight = height;
+
+    return this;
+}
+
+module.exports = (Pixels) => {
+    Pixels.prototype.crop = crop;
+};
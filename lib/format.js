@@ -7,6 +7,8 @@
 
 'use strict';
 
+const is = require('./is');
+
 /**
  * Supported pixel formats.
  * 
@@ -14,11 +16,36 @@
  */
 const gPixelFormats = new Set(['rgba', 'argb', 'abgr', 'bgra', 'keep']);
 
+/**
+ * Tensor memory layouts. nchw stores each channel as a separate plane. nhwc interleaves the channels of each pixel.
+ *
+ * @typedef {('nchw'|'nhwc')} TensorLayout
+ */
+const gTensorLayouts = new Set(['nchw', 'nhwc']);
+
+/**
+ * Tensor element types.
+ *
+ * @typedef {('float32'|'uint8')} TensorType
+ */
+const gTensorTypes = new Set(['float32', 'uint8']);
+
 /**
  * Configures the pipeline to output the image as raw bytes.
  *
+ * If shared is set, the pixels are written to a SharedArrayBuffer instead of a Buffer, so they can be handed to
+ * worker threads without copying. With shared set to true, a SharedArrayBuffer of the output size is created for each
+ * load. A SharedArrayBuffer can also be passed in, in which case the pixels are written at the start of it. Either
+ * way, the result is a Uint8Array view of the SharedArrayBuffer with a header field.
+ *
+ * If premultiplied is set, colors are multiplied by alpha, as GL and canvas compositing expect. Resizes then filter
+ * the premultiplied pixels directly rather than converting to and from premultiplied alpha around the resize. The
+ * resize background is premultiplied too.
+ *
  * @arg {Object} [options]
  * @arg {PixelFormat} options.format The pixel format of the raw bytes.
+ * @arg {boolean|SharedArrayBuffer} [options.shared] Output to a new or the given SharedArrayBuffer.
+ * @arg {boolean} [options.premultiplied=false] Output colors premultiplied by alpha.
  * @returns {Pipeline}
  * @method Pipeline#bytes
  */
@@ -26,16 +53,85 @@ function bytes(options) {
     this.request.output = 'bytes';
 
     if (options) {
-        if ('format' in options && !gPixelFormats.has(options.format)) {
-            throw Error('Invalid pixel format option: ' + options.format + '. Valid values: ' + Array.from(gPixelFormats).join(', '));
+        'format' in options && checkPixelFormat(options.format);
+
+        if ('shared' in options && typeof options.shared !== 'boolean' && !(options.shared instanceof SharedArrayBuffer)) {
+            throw Error('Invalid shared option: ' + options.shared + '. Should be a boolean or a SharedArrayBuffer.');
         }
 
-        this.request.outputOptions.format = options.format;
+        if ('premultiplied' in options && typeof options.premultiplied !== 'boolean') {
+            throw Error('Invalid premultiplied option: ' + options.premultiplied + '. Should be a boolean.');
+        }
+
+        'format' in options && (this.request.outputOptions.format = options.format);
+        'shared' in options && (this.request.outputOptions.shared = options.shared);
+        'premultiplied' in options && (this.request.outputOptions.premultiplied = options.premultiplied);
+    }
+
+    return this;
+}
+
+/**
+ * Configures the pipeline to output the image as an RGB tensor for machine learning inference. Alpha is dropped.
+ *
+ * float32 elements are normalized to (value / 255 - mean) / std per channel, in the same pass that converts the
+ * resized pixels, so no intermediate copy of the image is made in javascript. uint8 elements are the channel values
+ * as they are, and mean and std are ignored.
+ *
+ * The result is a Float32Array (or a Uint8Array for uint8) with a header field, which also has layout and dtype set.
+ * When written to a target, the result is a Uint8Array view of the target, as with bytes(). To build a batch, load
+ * each image into the same target with a different index. Target stride is not supported.
+ *
+ * @arg {Object} [options]
+ * @arg {number[]} [options.mean=[0, 0, 0]] Per channel mean, on a 0 to 1 scale.
+ * @arg {number[]} [options.std=[1, 1, 1]] Per channel standard deviation, on a 0 to 1 scale.
+ * @arg {TensorLayout} [options.layout='nchw'] Memory layout.
+ * @arg {TensorType} [options.dtype='float32'] Element type.
+ * @returns {Pipeline}
+ * @method Pipeline#tensor
+ */
+function tensor(options) {
+    const { mean = [0, 0, 0], std = [1, 1, 1], layout = 'nchw', dtype = 'float32' } = options || {};
+
+    checkChannelValues('mean', mean, value => is.number(value));
+    checkChannelValues('std', std, value => is.number(value) && value > 0);
+
+    if (!gTensorLayouts.has(layout)) {
+        throw Error('Invalid tensor layout: ' + layout + '. Valid values: ' + Array.from(gTensorLayouts).join(', '));
     }
 
+    if (!gTensorTypes.has(dtype)) {
+        throw Error('Invalid tensor dtype: ' + dtype + '. Valid values: ' + Array.from(gTensorTypes).join(', '));
+    }
+
+    this.request.output = 'tensor';
+    this.request.outputOptions = {
+        format: 'keep',
+        shared: false,
+        layout,
+        dtype,
+        mean: mean.slice(),
+        std: std.slice(),
+    };
+
     return this;
 }
 
+function checkChannelValues(name, values, isValid) {
+    if (!Array.isArray(values) || values.length !== 3 || !values.every(isValid)) {
+        throw Error(`Invalid tensor ${name}: ${values}. Should be an array of 3 numbers.`);
+    }
+}
+
+function checkPixelFormat(format) {
+    if (!gPixelFormats.has(format)) {
+        throw Error('Invalid pixel format option: ' + format + '. Valid values: ' + Array.from(gPixelFormats).join(', '));
+    }
+}
+
 module.exports = (Pixels) => {
     Pixels.prototype.bytes = bytes;
+    Pixels.prototype.tensor = tensor;
 };
+
+module.exports.checkPixelFormat = checkPixelFormat;
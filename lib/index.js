@@ -13,5 +13,10 @@ require('./format')(Pipeline);
 require('./output')(Pipeline);
 require('./config')(Pipeline);
 require('./resize')(Pipeline);
+require('./crop')(Pipeline);
+require('./batch')(Pipeline);
+require('./atlas')(Pipeline);
+require('./compile')(Pipeline);
+require('./scan')(Pipeline);
 
 module.exports = Pipeline;
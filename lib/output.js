@@ -7,6 +7,8 @@
 
 'use strict';
 
+const is = require('./is');
+const { checkPixelFormat } = require('./format');
 const native = require('bindings')('pixels-please');
 
 /**
@@ -18,6 +20,53 @@ const native = require('bindings')('pixels-please');
  * @property {int} channels The number of channels per pixel.
  *
  * @property {PixelFormat} [format] Pixel format of raw bytes.
+ * @property {int} [offset] Byte offset of the first row, when written to a target.
+ * @property {int} [stride] Bytes between the starts of consecutive rows, when written to a target.
+ * @property {int} [frame] Index of an animation frame.
+ * @property {int} [delay] Milliseconds to show an animation frame for.
+ * @property {int} [frames] Number of frames in an animation.
+ * @property {TensorLayout} [layout] Memory layout of a tensor.
+ * @property {TensorType} [dtype] Element type of a tensor.
+ * @property {int[]} [offsets] Byte offset of each image in a batch.
+ * @property {int} [index] Index of the source in a bulk load.
+ */
+
+/**
+ * Output destination options.
+ *
+ * When a target is given, the pixels are written directly into its memory instead of a newly allocated Buffer. The
+ * first row starts offset bytes into the target and each following row starts stride bytes after the previous one,
+ * so an image can be placed into a region of a texture atlas or a slot of a ring buffer. The target must be large
+ * enough for the output image at the given offset and stride. If it is not, the load fails. The target must not be
+ * transferred or detached while a load into it is pending.
+ *
+ * The result is a Uint8Array view of the whole target with a header field.
+ *
+ * When index is set, target holds a batch of equally sized images back to back from offset, and the image is written
+ * to the slot at index.
+ *
+ * @typedef {Object} OutputOptions
+ * @property {Buffer|TypedArray|DataView|ArrayBuffer|SharedArrayBuffer} [target] Memory to write the pixels into.
+ * @property {int} [offset=0] Byte offset of the first row in target.
+ * @property {int} [stride] Bytes between rows in target. Defaults to the output row size.
+ * @property {int} [index=0] Slot of the image in a batch stored in target.
+ */
+
+/**
+ * One output of a multi-size load.
+ *
+ * @typedef {Object} OutputSize
+ * @property {int} width Resize bounding box width, applied with the pipeline's resize settings.
+ * @property {int} height Resize bounding box height.
+ * @property {PixelFormat} [format] Pixel format of this output. Defaults to the format set with bytes().
+ */
+
+/**
+ * Multi-size output options.
+ *
+ * @typedef {Object} OutputSizesOptions
+ * @property {boolean} [cascade=false] Resize each output from the next larger one instead of the source image. Faster
+ * when the source is much larger than the outputs, at some cost in quality.
  */
 
 /**
@@ -28,23 +77,13 @@ const native = require('bindings')('pixels-please');
  *
  * If no format is specified, the default format will be bytes.
  *
- * @returns {Promise<Buffer>}
+ * @arg {OutputOptions} [options]
+ * @returns {Promise<Buffer|Uint8Array>} A Uint8Array over the target or the SharedArrayBuffer when either is used.
+ * @throws {Error} when options are invalid
  * @method Pipeline#toBuffer
  */
-function toBuffer() {
-    const pixels = this;
-
-    return new Promise(function(resolve, reject) {
-        native.loadPipeline(pixels.request, false, (event, payload) => {
-            if (event === 'header') {
-                // ignore
-            } else if (event === 'data') {
-                resolve(payload);
-            } else {
-                reject(payload);
-            }
-        });
-    });
+function toBuffer(options) {
+    return native.loadPipeline(this.request, false, getTarget(this.request, options));
 }
 
 /**
@@ -54,11 +93,43 @@ function toBuffer() {
  *
  * If no format is specified, the default format will be bytes.
  *
- * @returns {Buffer}
+ * @arg {OutputOptions} [options]
+ * @returns {Buffer|Uint8Array} A Uint8Array over the target or the SharedArrayBuffer when either is used.
+ * @throws {Error} when options are invalid
  * @method Pipeline#toBufferSync
  */
-function toBufferSync() {
-    return native.loadPipelineSync(this.request, false);
+function toBufferSync(options) {
+    return native.loadPipelineSync(this.request, false, getTarget(this.request, options));
+}
+
+/**
+ * Output image to several Buffers, one for each size, from a single decode of the source image. Outputs are resized
+ * from the largest to the smallest. SVG sources are rasterized once per size, without resizing.
+ *
+ * Each buffer has an extended field header of type Header.
+ *
+ * @arg {OutputSize[]} sizes
+ * @arg {OutputSizesOptions} [options]
+ * @returns {Promise<Buffer[]>} The buffers in the order of sizes.
+ * @throws {Error} when sizes or options are invalid
+ * @method Pipeline#toBuffers
+ */
+function toBuffers(sizes, options) {
+    return native.loadPipeline(getSizesRequest(this.request, sizes, options), false);
+}
+
+/**
+ * Output image to several Buffers, one for each size, from a single decode of the source image. This operation occurs
+ * synchronously on Node's main thread.
+ *
+ * @arg {OutputSize[]} sizes
+ * @arg {OutputSizesOptions} [options]
+ * @returns {Buffer[]} The buffers in the order of sizes.
+ * @throws {Error} when sizes or options are invalid
+ * @method Pipeline#toBuffersSync
+ */
+function toBuffersSync(sizes, options) {
+    return native.loadPipelineSync(getSizesRequest(this.request, sizes, options), false);
 }
 
 /**
@@ -69,14 +140,7 @@ function toBufferSync() {
  * @method Pipeline#toHeader
  */
 function toHeader() {
-    const pixels = this;
-
-    return new Promise(function(resolve, reject) {
-        native.loadPipeline(
-            pixels.request,
-            true,
-            (event, payload) => (event === 'header') ? resolve(payload) : reject(payload));
-    });
+    return native.loadPipeline(this.request, true);
 }
 
 /**
@@ -89,9 +153,139 @@ function toHeaderSync() {
     return native.loadPipelineSync(this.request, true);
 }
 
+/**
+ * Output every frame of an animated GIF. Frames are decoded in a background thread and passed to onFrame in order as
+ * each one is ready, so playback can start before the whole animation is decoded. Each frame is a complete image,
+ * composited over the frames before it, and is resized in the same pass when the pipeline has a resize step.
+ *
+ * Each frame Buffer has an extended field header of type Header, with frame and delay set. Other image formats
+ * produce a single frame.
+ *
+ * If onFrame throws, no more frames are decoded and the returned promise rejects with the thrown error.
+ *
+ * @arg {function(Buffer)} onFrame Called on the main thread with each frame.
+ * @returns {Promise<Header>} Resolves after the last frame, with frames set to the number of frames.
+ * @throws {Error} when onFrame is not a function or shared output was requested
+ * @method Pipeline#toFrames
+ */
+function toFrames(onFrame) {
+    checkFrameOutput(this.request, onFrame);
+
+    return native.loadPipeline(this.request, false, undefined, onFrame);
+}
+
+/**
+ * Output every frame of an animated GIF. This operation occurs synchronously on Node's main thread, with onFrame
+ * called as each frame is decoded.
+ *
+ * @arg {function(Buffer)} onFrame Called with each frame.
+ * @returns {Header} The header of the animation, with frames set to the number of frames.
+ * @throws {Error} when onFrame is not a function, shared output was requested, the image fails to load or onFrame throws
+ * @method Pipeline#toFramesSync
+ */
+function toFramesSync(onFrame) {
+    checkFrameOutput(this.request, onFrame);
+
+    return native.loadPipelineSync(this.request, false, undefined, onFrame);
+}
+
+function checkFrameOutput(request, onFrame) {
+    if (typeof onFrame !== 'function') {
+        throw Error(`Invalid frame callback: ${onFrame}. Should be a function.`);
+    }
+
+    if (request.outputOptions.shared !== false) {
+        throw Error('Shared output is not supported for frames.');
+    }
+
+    if (request.output === 'tensor') {
+        throw Error('Tensor output is not supported for frames.');
+    }
+}
+
+function getSizesRequest(request, sizes, options) {
+    if (!Array.isArray(sizes) || sizes.length === 0) {
+        throw Error(`Invalid sizes: ${sizes}. Should be a non-empty array.`);
+    }
+
+    if (request.outputOptions.shared !== false) {
+        throw Error('Shared output is not supported for multiple sizes.');
+    }
+
+    if (request.output === 'tensor') {
+        throw Error('Tensor output is not supported for multiple sizes.');
+    }
+
+    const outputs = sizes.map(size => {
+        const { width, height } = size || {};
+        const format = (size && 'format' in size) ? size.format : request.outputOptions.format;
+
+        if (!is.int(width) || width <= 0) {
+            throw Error(`Invalid width of ${width}. Should be a positive integer.`);
+        }
+
+        if (!is.int(height) || height <= 0) {
+            throw Error(`Invalid height of ${height}. Should be a positive integer.`);
+        }
+
+        checkPixelFormat(format);
+
+        return { width, height, format };
+    });
+
+    return Object.assign({}, request, { outputs, outputCascade: !!(options && options.cascade) });
+}
+
+function getTarget(request, options) {
+    const shared = request.outputOptions.shared;
+
+    if (options && 'target' in options) {
+        const offset = ('offset' in options) ? options.offset : 0;
+        const stride = ('stride' in options) ? options.stride : 0;
+        const index = ('index' in options) ? options.index : 0;
+
+        if (!is.int(offset) || offset < 0) {
+            throw Error(`Invalid target offset of ${offset}. Should be a non-negative integer.`);
+        }
+
+        if (!is.int(stride) || stride < 0) {
+            throw Error(`Invalid target stride of ${stride}. Should be a non-negative integer.`);
+        }
+
+        if (!is.int(index) || index < 0) {
+            throw Error(`Invalid target index of ${index}. Should be a non-negative integer.`);
+        }
+
+        if (stride !== 0 && request.output === 'tensor') {
+            throw Error('Target stride is not supported for tensors.');
+        }
+
+        return { target: toUint8Array(options.target), offset, stride, index };
+    }
+
+    return (shared instanceof SharedArrayBuffer) ? { target: new Uint8Array(shared), offset: 0, stride: 0, index: 0 } : undefined;
+}
+
+function toUint8Array(target) {
+    // The native side can only read memory through typed array views.
+    if (ArrayBuffer.isView(target)) {
+        return new Uint8Array(target.buffer, target.byteOffset, target.byteLength);
+    } else if (target instanceof ArrayBuffer || target instanceof SharedArrayBuffer) {
+        return new Uint8Array(target);
+    }
+
+    throw Error('Invalid target: ' + target + '. Should be a Buffer, TypedArray, DataView, ArrayBuffer or SharedArrayBuffer.');
+}
+
 module.exports = (Pixels) => {
     Pixels.prototype.toHeader = toHeader;
     Pixels.prototype.toHeaderSync = toHeaderSync;
     Pixels.prototype.toBuffer = toBuffer;
     Pixels.prototype.toBufferSync = toBufferSync;
+    Pixels.prototype.toBuffers = toBuffers;
+    Pixels.prototype.toBuffersSync = toBuffersSync;
+    Pixels.prototype.toFrames = toFrames;
+    Pixels.prototype.toFramesSync = toFramesSync;
 };
+
+module.exports.getTarget = getTarget;
@@ -33,15 +33,26 @@ function Pipeline(source) {
 
         output: 'bytes',
         outputOptions: {
-            format: 'keep'
+            format: 'keep',
+            shared: false,
+            premultiplied: false,
         },
 
         resizeWidth: 0,
         resizeHeight: 0,
         resizeFilter: 'gaussian',
+        resizeEngine: 'float',
+        resizeStrategy: 'exact',
         resizeConstraint: 'fit',
+        resizeGravity: 'center',
+        resizeBackground: [0, 0, 0, 0],
         resizeDisableDecoderScaling: false,
         resizeIgnoreAspectRatio: false,
+
+        cropX: 0,
+        cropY: 0,
+        cropWidth: 0,
+        cropHeight: 0,
     };
     
     return this;
@@ -10,11 +10,36 @@
 const is = require('./is');
 
 /**
- * Supported resize filter formats.
+ * Supported resize filter formats. 'nearest' copies the closest source pixel without smoothing, which keeps pixel art
+ * crisp when scaled by whole factors.
  *
- * @typedef {('box'|'tent'|'gaussian')} Filter
+ * @typedef {('box'|'tent'|'gaussian'|'nearest')} Filter
  */
-const gFilters = new Set(['box', 'tent', 'gaussian']);
+const gFilters = new Set(['box', 'tent', 'gaussian', 'nearest']);
+
+/**
+ * Resize implementations. 'float' is stb_image_resize. 'fixed' resizes 8 bit pixels with integer arithmetic, which is
+ * faster and within 1 of 'float' on every channel.
+ *
+ * @typedef {('float'|'fixed')} ResizeEngine
+ */
+const gEngines = new Set(['float', 'fixed']);
+
+/**
+ * Resize strategies. 'exact' applies the filter to the full resolution image. 'fast' first halves the image with a
+ * 2x2 box filter until it is within 2x of the output size and applies the filter to the rest. Large reductions are many
+ * times faster and reductions by a power of two are done by halving alone.
+ *
+ * @typedef {('exact'|'fast')} ResizeStrategy
+ */
+const gStrategies = new Set(['exact', 'fast']);
+
+/**
+ * Part of the image kept when a resize constraint crops.
+ *
+ * @typedef {('center'|'north'|'south'|'east'|'west'|'northeast'|'northwest'|'southeast'|'southwest')} Gravity
+ */
+const gGravities = new Set(['center', 'north', 'south', 'east', 'west', 'northeast', 'northwest', 'southeast', 'southwest']);
 
 /**
  * Resize an image.
@@ -64,6 +89,59 @@ function fit() {
     return this;
 }
 
+/**
+ * Resize an image to exactly fill the resize bounding box, preserving aspect ratio. The image is scaled until it
+ * covers the bounding box and the part that overflows it is cropped, keeping the side given by gravity.
+ *
+ * Only the part of the image that is kept is resized, in a single pass.
+ *
+ * @arg {Gravity} [gravity='center'] Part of the image to keep.
+ * @returns {Pipeline}
+ * @method Pipeline#cover
+ */
+function cover(gravity = 'center') {
+    if (!gGravities.has(gravity)) {
+        throw Error(`Invalid gravity option: ${gravity}. Valid values: ${Array.from(gGravities).join(', ')}`);
+    }
+
+    this.request.resizeConstraint = 'cover';
+    this.request.resizeGravity = gravity;
+
+    return this;
+}
+
+/**
+ * Resize an image to fit inside the resize bounding box, preserving aspect ratio, and output it on a canvas of
+ * exactly the bounding box size. The image is placed on the canvas by gravity and the rest of the canvas is filled
+ * with the background color.
+ *
+ * The image is resized straight into the canvas, in a single pass.
+ *
+ * @arg {Object} [options]
+ * @arg {int[]} [options.background=[0, 0, 0, 0]] Background color as [red, green, blue, alpha], each from 0 to 255.
+ * @arg {Gravity} [options.gravity='center'] Where to place the image on the canvas.
+ * @returns {Pipeline}
+ * @method Pipeline#pad
+ */
+function pad(options) {
+    const { background = [0, 0, 0, 0], gravity = 'center' } = options || {};
+
+    if (!Array.isArray(background) || background.length !== 4
+            || !background.every(component => is.int(component) && component >= 0 && component <= 255)) {
+        throw Error(`Invalid background option: ${background}. Should be [red, green, blue, alpha] integers from 0 to 255.`);
+    }
+
+    if (!gGravities.has(gravity)) {
+        throw Error(`Invalid gravity option: ${gravity}. Valid values: ${Array.from(gGravities).join(', ')}`);
+    }
+
+    this.request.resizeConstraint = 'pad';
+    this.request.resizeGravity = gravity;
+    this.request.resizeBackground = background.slice();
+
+    return this;
+}
+
 /**
  * The resize algorithm to use.
  *
@@ -74,6 +152,8 @@ function fit() {
  * @arg {Filter} filter Resize filter algorithm.
  * @arg options
  * @arg {boolean} options.disableDecoderScaling Force the resize operation to use the specified resize filter.
+ * @arg {ResizeEngine} [options.engine='float'] Resize implementation that applies the filter.
+ * @arg {ResizeStrategy} [options.strategy='exact'] How much of the reduction the filter is applied to.
  * @returns {Pipeline}
  * @method Pipeline#filter
  */
@@ -82,8 +162,18 @@ function filter(filter, options) {
         throw Error(`Invalid resize filter option: ${options.format}. Valid values: ${Array.from(gFilters).join(', ')}`);
     }
 
+    if (options && options.engine !== undefined && !gEngines.has(options.engine)) {
+        throw Error(`Invalid resize engine option: ${options.engine}. Valid values: ${Array.from(gEngines).join(', ')}`);
+    }
+
+    if (options && options.strategy !== undefined && !gStrategies.has(options.strategy)) {
+        throw Error(`Invalid resize strategy option: ${options.strategy}. Valid values: ${Array.from(gStrategies).join(', ')}`);
+    }
+
     this.request.resizeFilter = filter;
     options && (this.request.resizeDisableDecoderScaling = !!options.disableDecoderScaling);
+    options && options.engine && (this.request.resizeEngine = options.engine);
+    options && options.strategy && (this.request.resizeStrategy = options.strategy);
 
     return this;
 }
@@ -101,5 +191,5 @@ function ignoreAspectRatio() {
 }
 
 module.exports = (Pixels) => {
-    Object.assign(Pixels.prototype, { resize, contain, fit, filter, ignoreAspectRatio });
+    Object.assign(Pixels.prototype, { resize, contain, fit, cover, pad, filter, ignoreAspectRatio });
 };
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+'use strict';
+
+const fs = require('fs');
+const path = require('path');
+const is = require('./is');
+
+/**
+ * File extensions scanned when no filter is given.
+ */
+const gImageExtensions = new Set(['.jpg', '.jpeg', '.png', '.tga', '.bmp', '.psd', '.gif', '.hdr', '.pic', '.ppm', '.pgm', '.svg']);
+
+/**
+ * Directory scan options.
+ *
+ * @typedef {Object} ScanOptions
+ * @property {int} [concurrency] Number of loads in flight at any time. Defaults to the thread pool size.
+ * @property {boolean} [recursive=false] Scan subdirectories as well.
+ * @property {function(string): boolean} [filter] Called with the path of each file. Only files it returns true for
+ * are loaded. Defaults to files with the extension of a supported image format.
+ * @property {CompiledPipeline} [pipeline] Settings to load each file with. Defaults to bytes in the source format.
+ */
+
+/**
+ * Load every image in a directory, keeping a fixed number of loads in flight on the thread pool.
+ *
+ * Returns an async iterator of results in the order the loads finish. Directory entries are read as loads complete
+ * rather than all up front, so memory stays bounded by the concurrency on trees of any size. A file that fails to load
+ * does not end the scan. Its result is the Error instead. Each result has a source property with the file path, in
+ * its header for buffers and on the Error itself for failures.
+ *
+ * On Node versions without fs.promises.opendir (before 12.12), each directory is listed in full as it is reached.
+ *
+ * @example
+ * for await (const buffer of Pipeline.scan('assets', {recursive: true})) {
+ *     // ...
+ * }
+ *
+ * @arg {string} dir Directory to scan.
+ * @arg {ScanOptions} [options]
+ * @returns {AsyncIterableIterator<Buffer|Uint8Array|Error>}
+ * @throws {Error} when dir or options are invalid
+ * @static
+ * @method Pipeline.scan
+ */
+function scan(dir, options) {
+    const {
+        concurrency = this.threads,
+        recursive = false,
+        filter = isImageFile,
+        pipeline = this.compile({}),
+    } = options || {};
+
+    if (!dir || !is.string(dir)) {
+        throw Error(`Invalid directory: ${dir}.`);
+    }
+
+    if (!is.int(concurrency) || concurrency <= 0) {
+        throw Error(`Invalid concurrency of ${concurrency}. Should be a positive integer.`);
+    }
+
+    if (typeof filter !== 'function') {
+        throw Error(`Invalid filter: ${filter}. Should be a function.`);
+    }
+
+    if (!pipeline || typeof pipeline.run !== 'function') {
+        throw Error(`Invalid pipeline: ${pipeline}. Should be a CompiledPipeline.`);
+    }
+
+    return scanResults(walk(dir, !!recursive, filter), pipeline, concurrency);
+}
+
+async function* scanResults(sources, pipeline, concurrency) {
+    const pending = new Set();
+    let walking = true;
+
+    const fill = async () => {
+        while (walking && pending.size < concurrency) {
+            const next = await sources.next();
+
+            if (next.done) {
+                walking = false;
+                break;
+            }
+
+            const source = next.value;
+            const load = pipeline.run(source)
+                .then(buffer => {
+                    buffer.header.source = source;
+                    return buffer;
+                }, error => {
+                    error.source = source;
+                    return error;
+                })
+                .then(result => ({ load, result }));
+
+            pending.add(load);
+        }
+    };
+
+    try {
+        await fill();
+
+        while (pending.size) {
+            const { load, result } = await Promise.race(pending);
+
+            // Start the next load before handing this result over, so the pool stays busy while the caller works.
+            pending.delete(load);
+            await fill();
+
+            yield result;
+        }
+    } finally {
+        // Closes the directory when the caller stops early.
+        await sources.return();
+    }
+}
+
+async function* walk(dir, recursive, filter) {
+    for await (const entry of await readDir(dir)) {
+        const filename = path.join(dir, entry.name);
+
+        if (entry.isDirectory()) {
+            if (recursive) {
+                yield* walk(filename, recursive, filter);
+            }
+        } else if (entry.isFile() && filter(filename)) {
+            yield filename;
+        }
+    }
+}
+
+function readDir(dir) {
+    return fs.promises.opendir ? fs.promises.opendir(dir) : fs.promises.readdir(dir, {withFileTypes: true});
+}
+
+function isImageFile(filename) {
+    return gImageExtensions.has(path.extname(filename).toLowerCase());
+}
+
+module.exports = (Pixels) => {
+    Pixels.scan = scan;
+};
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+#include "Addon.h"
+
+using namespace Napi;
+
+Addon::Addon(Env env) {
+    this->completionQueue = CompletionQueue::New(env);
+}
+
+Addon::~Addon() {
+    this->completionQueue->Close();
+
+    // Buffers still held by javascript when the environment goes away.
+    for (auto& allocation : this->bufferAllocations) {
+        free(allocation.first);
+    }
+}
+
+void Addon::Init(Env env) {
+    auto addon = new Addon(env);
+
+    if (napi_set_instance_data(env, addon, Addon::Finalize, nullptr) != napi_ok) {
+        delete addon;
+        throw Error::New(env, "Failed to set addon instance data.");
+    }
+}
+
+Addon *Addon::Get(Env env) {
+    void *data = nullptr;
+
+    napi_get_instance_data(env, &data);
+
+    return static_cast<Addon *>(data);
+}
+
+void Addon::Finalize(napi_env env, void *data, void *hint) {
+    delete static_cast<Addon *>(data);
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+#ifndef ADDON_H
+#define ADDON_H
+
+#include <napi.h>
+#include <map>
+#include <memory>
+#include <string>
+#include "Completion.h"
+
+class Job;
+
+// Per-environment addon state. The main thread and every worker thread that loads the addon get their own instance,
+// attached to their napi_env as instance data. State shared by all environments (the thread pool) lives elsewhere.
+class Addon {
+    private:
+        Addon(Napi::Env env);
+
+        static void Finalize(napi_env env, void *data, void *hint);
+
+    public:
+        ~Addon();
+
+        std::shared_ptr<CompletionQueue> completionQueue;
+        // Result memory held by javascript buffers, with the number of buffers over it.
+        std::map<void *, size_t> bufferAllocations;
+        // Jobs that identical loads can join until they complete, by request key.
+        std::map<std::string, std::shared_ptr<Job>> coalescedJobs;
+
+        static void Init(Napi::Env env);
+        static Addon *Get(Napi::Env env);
+};
+
+#endif
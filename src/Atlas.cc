@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+#include "Atlas.h"
+#include <algorithm>
+#include <climits>
+
+SkylinePacker::SkylinePacker(const int width, const int height) {
+    this->width = width;
+    this->height = height;
+    this->usedWidth = 0;
+    this->usedHeight = 0;
+    this->skyline.push_back({ 0, 0, width });
+}
+
+// Top of a width x height rectangle whose left edge is on the given segment, resting on the skyline. -1 when it would
+// stick out of the page.
+int SkylinePacker::Fit(const size_t segment, const int width, const int height) const {
+    if (this->skyline[segment].x + width > this->width) {
+        return -1;
+    }
+
+    auto y = 0;
+
+    // The segments cover the page, so those under the rectangle end before the skyline does.
+    for (auto i = segment, remaining = (size_t)width; remaining > 0; i++) {
+        y = std::max(y, this->skyline[i].y);
+
+        if (y + height > this->height) {
+            return -1;
+        }
+
+        remaining -= std::min(remaining, (size_t)this->skyline[i].width);
+    }
+
+    return y;
+}
+
+bool SkylinePacker::Insert(const int width, const int height, int *x, int *y) {
+    auto best = this->skyline.size();
+    auto bestBottom = INT_MAX;
+    auto bestY = 0;
+
+    // Leftmost wins ties, as the segments are visited from the left.
+    for (size_t i = 0; i < this->skyline.size(); i++) {
+        auto top = this->Fit(i, width, height);
+
+        if (top >= 0 && top + height < bestBottom) {
+            best = i;
+            bestBottom = top + height;
+            bestY = top;
+        }
+    }
+
+    if (best == this->skyline.size()) {
+        return false;
+    }
+
+    auto left = this->skyline[best].x;
+    auto right = left + width;
+
+    this->skyline.insert(this->skyline.begin() + best, { left, bestBottom, width });
+
+    // The rectangle covers the segments after it up to its right edge.
+    for (auto i = best + 1; i < this->skyline.size() && this->skyline[i].x < right; ) {
+        auto& segment = this->skyline[i];
+
+        if (segment.x + segment.width <= right) {
+            this->skyline.erase(this->skyline.begin() + i);
+        } else {
+            segment.width -= right - segment.x;
+            segment.x = right;
+            break;
+        }
+    }
+
+    // Neighbours at the same height become one segment, keeping the skyline short.
+    for (size_t i = 0; i + 1 < this->skyline.size(); ) {
+        if (this->skyline[i].y == this->skyline[i + 1].y) {
+            this->skyline[i].width += this->skyline[i + 1].width;
+            this->skyline.erase(this->skyline.begin() + i + 1);
+        } else {
+            i++;
+        }
+    }
+
+    this->usedWidth = std::max(this->usedWidth, right);
+    this->usedHeight = std::max(this->usedHeight, bestBottom);
+    *x = left;
+    *y = bestY;
+
+    return true;
+}
+
+AtlasPacker::AtlasPacker(const int maxSize, const int padding) {
+    this->maxSize = maxSize;
+    this->padding = padding;
+}
+
+bool AtlasPacker::Pack(std::vector<AtlasRect>& rects) {
+    std::vector<size_t> order(rects.size());
+
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+
+        if (rects[i].GetWidth() > this->maxSize || rects[i].GetHeight() > this->maxSize) {
+            return false;
+        }
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&rects](const size_t a, const size_t b) {
+        return rects[a].GetHeight() != rects[b].GetHeight() ? rects[a].GetHeight() > rects[b].GetHeight()
+            : rects[a].GetWidth() > rects[b].GetWidth();
+    });
+
+    // Every rectangle claims padding more pixels to its right and below it. Pages are as much larger, so rectangles
+    // can still reach their right and bottom edges.
+    for (auto i : order) {
+        auto& rect = rects[i];
+        auto width = rect.GetWidth() + this->padding;
+        auto height = rect.GetHeight() + this->padding;
+        int x;
+        int y;
+        size_t page = 0;
+
+        while (page < this->pages.size() && !this->pages[page].Insert(width, height, &x, &y)) {
+            page++;
+        }
+
+        if (page == this->pages.size()) {
+            this->pages.push_back(SkylinePacker(this->maxSize + this->padding, this->maxSize + this->padding));
+            this->pages[page].Insert(width, height, &x, &y);
+        }
+
+        rect.Place((int)page, x, y);
+    }
+
+    return true;
+}
+
+int AtlasPacker::GetPageWidth(const int page) const {
+    return this->pages[page].GetUsedWidth() - this->padding;
+}
+
+int AtlasPacker::GetPageHeight(const int page) const {
+    return this->pages[page].GetUsedHeight() - this->padding;
+}
+
+bool FindAlphaBounds(const unsigned char *pixels, const int width, const int height, const size_t stride, int *left,
+        int *top, int *right, int *bottom) {
+    auto opaque = [pixels, stride](const int x, const int y) {
+        return pixels[(size_t)y*stride + (size_t)x*4 + 3] != 0;
+    };
+    auto rowOpaque = [width, &opaque](const int y) {
+        for (int x = 0; x < width; x++) {
+            if (opaque(x, y)) {
+                return true;
+            }
+        }
+
+        return false;
+    };
+    auto minY = 0;
+    auto maxY = height;
+
+    while (minY < height && !rowOpaque(minY)) {
+        minY++;
+    }
+
+    if (minY == height) {
+        return false;
+    }
+
+    while (!rowOpaque(maxY - 1)) {
+        maxY--;
+    }
+
+    // Each row only has to be searched outside of the columns already known to be inside.
+    auto minX = width;
+    auto maxX = 0;
+
+    for (int y = minY; y < maxY; y++) {
+        for (int x = 0; x < minX; x++) {
+            if (opaque(x, y)) {
+                minX = x;
+                break;
+            }
+        }
+
+        for (int x = width - 1; x >= maxX; x--) {
+            if (opaque(x, y)) {
+                maxX = x + 1;
+                break;
+            }
+        }
+    }
+
+    *left = minX;
+    *top = minY;
+    *right = maxX;
+    *bottom = maxY;
+
+    return true;
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <cstddef>
+#include <vector>
+
+// A rectangle to pack, and where it was placed.
+class AtlasRect {
+    private:
+        int width;
+        int height;
+        int page;
+        int x;
+        int y;
+
+    public:
+        AtlasRect(const int width, const int height) {
+            this->width = width;
+            this->height = height;
+            this->page = -1;
+            this->x = 0;
+            this->y = 0;
+        }
+
+        int GetWidth() const {
+            return this->width;
+        }
+
+        int GetHeight() const {
+            return this->height;
+        }
+
+        int GetPage() const {
+            return this->page;
+        }
+
+        int GetX() const {
+            return this->x;
+        }
+
+        int GetY() const {
+            return this->y;
+        }
+
+        void Place(const int page, const int x, const int y) {
+            this->page = page;
+            this->x = x;
+            this->y = y;
+        }
+};
+
+// Packs rectangles into one page with the skyline bottom left heuristic. The skyline is the bottom edge of everything
+// placed so far. Each rectangle goes where its bottom edge ends up highest, leftmost among equals. Space under an
+// overhang is given up, which keeps each placement linear in the length of the skyline.
+class SkylinePacker {
+    private:
+        struct Segment {
+            int x;
+            int y;
+            int width;
+        };
+
+        int width;
+        int height;
+        int usedWidth;
+        int usedHeight;
+        // Left to right, covering the page.
+        std::vector<Segment> skyline;
+
+        int Fit(const size_t segment, const int width, const int height) const;
+
+    public:
+        SkylinePacker(const int width, const int height);
+
+        // Finds room for a width x height rectangle and claims it. False when it does not fit.
+        bool Insert(const int width, const int height, int *x, int *y);
+
+        // Extent of the placed rectangles.
+        int GetUsedWidth() const {
+            return this->usedWidth;
+        }
+
+        int GetUsedHeight() const {
+            return this->usedHeight;
+        }
+};
+
+// Packs rectangles onto as few pages of at most maxSize x maxSize pixels as it can, padding pixels apart. Taller
+// rectangles go first, each onto the first page with room for it.
+class AtlasPacker {
+    private:
+        int maxSize;
+        int padding;
+        std::vector<SkylinePacker> pages;
+
+    public:
+        AtlasPacker(const int maxSize, const int padding);
+
+        // Places every rectangle. False when one is larger than a page.
+        bool Pack(std::vector<AtlasRect>& rects);
+
+        int GetPageCount() const {
+            return (int)this->pages.size();
+        }
+
+        // Size of a page, cropped to the rectangles on it.
+        int GetPageWidth(const int page) const;
+        int GetPageHeight(const int page) const;
+};
+
+// Finds the smallest rectangle holding every pixel of 4 channel pixels with non-zero alpha, from (left, top) to
+// (right, bottom). False when every pixel is transparent.
+bool FindAlphaBounds(const unsigned char *pixels, const int width, const int height, const size_t stride, int *left,
+    int *top, int *right, int *bottom);
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+#include "Completion.h"
+
+using namespace Napi;
+
+CompletionQueue::CompletionQueue() {
+    this->dispatcher = nullptr;
+    this->pending = 0;
+    this->scheduled = false;
+    this->closed = false;
+}
+
+CompletionQueue::~CompletionQueue() {
+    Discard(this->completions);
+}
+
+std::shared_ptr<CompletionQueue> CompletionQueue::New(Env env) {
+    auto queue = std::shared_ptr<CompletionQueue>(new CompletionQueue());
+    // The threadsafe function keeps the queue alive until it is finalized, as Drain() receives it as a raw pointer.
+    auto owner = new std::shared_ptr<CompletionQueue>(queue);
+    napi_value resourceName;
+
+    if (napi_create_string_utf8(env, "pixels-please:completion", NAPI_AUTO_LENGTH, &resourceName) != napi_ok
+            || napi_create_threadsafe_function(env, nullptr, nullptr, resourceName, 0, 1, owner,
+                [](napi_env env, void *data, void *hint) {
+                    delete static_cast<std::shared_ptr<CompletionQueue> *>(data);
+                },
+                queue.get(), CompletionQueue::Drain, &queue->dispatcher) != napi_ok) {
+        delete owner;
+        throw Error::New(env, "Failed to create completion queue.");
+    }
+
+    // Idle until there is work in flight.
+    napi_unref_threadsafe_function(env, queue->dispatcher);
+
+    return queue;
+}
+
+void CompletionQueue::Ref(Env env) {
+    if (this->pending++ == 0 && !this->closed) {
+        napi_ref_threadsafe_function(env, this->dispatcher);
+    }
+}
+
+void CompletionQueue::Unref(Env env) {
+    if (--this->pending == 0 && !this->closed) {
+        napi_unref_threadsafe_function(env, this->dispatcher);
+    }
+}
+
+void CompletionQueue::Close() {
+    std::vector<Completion *> discarded;
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        if (this->closed) {
+            return;
+        }
+
+        this->closed = true;
+        discarded.swap(this->completions);
+    }
+
+    napi_release_threadsafe_function(this->dispatcher, napi_tsfn_abort);
+    Discard(discarded);
+}
+
+void CompletionQueue::Push(Completion *completion) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    if (this->closed) {
+        lock.unlock();
+        completion->Complete(nullptr);
+        delete completion;
+        return;
+    }
+
+    this->completions.push_back(completion);
+
+    // Only the first completion of a batch wakes the main thread. Drain() picks up everything queued until it runs.
+    if (this->scheduled) {
+        return;
+    }
+
+    auto status = napi_call_threadsafe_function(this->dispatcher, nullptr, napi_tsfn_nonblocking);
+
+    if (status == napi_ok) {
+        this->scheduled = true;
+    } else if (status == napi_closing) {
+        // The environment is being torn down and nothing queued can be delivered. Close() still releases the
+        // threadsafe function.
+        std::vector<Completion *> discarded;
+
+        discarded.swap(this->completions);
+        lock.unlock();
+        Discard(discarded);
+    }
+
+    // Otherwise the completions stay queued, and the next push tries to wake the main thread for all of them again.
+}
+
+void CompletionQueue::Drain(napi_env env, napi_value callback, void *context, void *data) {
+    auto queue = static_cast<CompletionQueue *>(context);
+
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+
+        queue->draining.swap(queue->completions);
+        queue->scheduled = false;
+    }
+
+    if (env == nullptr) {
+        Discard(queue->draining);
+        return;
+    }
+
+    for (auto completion : queue->draining) {
+        napi_handle_scope scope;
+
+        napi_open_handle_scope(env, &scope);
+        completion->Complete(env);
+        napi_close_handle_scope(env, scope);
+
+        delete completion;
+    }
+
+    queue->draining.clear();
+}
+
+void CompletionQueue::Discard(std::vector<Completion *>& completions) {
+    for (auto completion : completions) {
+        completion->Complete(nullptr);
+        delete completion;
+    }
+
+    completions.clear();
+}
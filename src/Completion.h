@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+#ifndef COMPLETION_H
+#define COMPLETION_H
+
+#include <napi.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Work finished on a pool thread that needs the main thread to deliver its result to javascript.
+class Completion {
+    public:
+        virtual ~Completion() {
+        }
+
+        // Called on the main thread inside a handle scope. env is null when the environment is being torn down and
+        // nothing can be delivered.
+        virtual void Complete(napi_env env) = 0;
+};
+
+// Collects completions from pool threads and delivers them on the main thread of one environment. Completions that
+// arrive while a delivery is already scheduled ride along with it, so a burst of N results costs one event loop wakeup
+// instead of N.
+//
+// Pool threads are shared by all environments and can outlive the one that scheduled their work, so jobs hold the
+// queue through a shared_ptr. Once the environment closes the queue, pushed completions are discarded.
+class CompletionQueue {
+    private:
+        std::mutex mutex;
+        std::vector<Completion *> completions;
+        std::vector<Completion *> draining;
+        napi_threadsafe_function dispatcher;
+        int pending;
+        // A Drain() call is queued on the threadsafe function and will pick up the completions.
+        bool scheduled;
+        bool closed;
+
+        CompletionQueue();
+
+        static void Drain(napi_env env, napi_value callback, void *context, void *data);
+        static void Discard(std::vector<Completion *>& completions);
+
+    public:
+        ~CompletionQueue();
+
+        static std::shared_ptr<CompletionQueue> New(Napi::Env env);
+
+        // Main thread. Keeps the event loop alive until the matching Unref(), for work that will push a completion.
+        void Ref(Napi::Env env);
+        void Unref(Napi::Env env);
+
+        // Main thread. Called when the environment is torn down.
+        void Close();
+
+        // Any thread. The queue owns the completion and deletes it after it is delivered.
+        void Push(Completion *completion);
+};
+
+#endif
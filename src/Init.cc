@@ -8,16 +8,31 @@
 #include <napi.h>
 #include "Threads.h"
 #include "Pipeline.h"
+#include "Addon.h"
 
 using namespace Napi;
 
 Object Init(Env env, Object exports) {
+    Addon::Init(env);
+
     exports["loadPipeline"] = Function::New(env, LoadPipeline, "loadPipeline");
     exports["loadPipelineSync"] = Function::New(env, LoadPipelineSync, "loadPipelineSync");
+    exports["loadPipelines"] = Function::New(env, LoadPipelines, "loadPipelines");
+    exports["loadAtlas"] = Function::New(env, LoadAtlas, "loadAtlas");
+    exports["loadAtlasSync"] = Function::New(env, LoadAtlasSync, "loadAtlasSync");
+    exports["compilePipeline"] = Function::New(env, CompilePipeline, "compilePipeline");
     exports["setThreadPoolSize"] = Function::New(env, SetThreadPoolSize, "setThreadPoolSize");
     exports["getThreadPoolSize"] = Function::New(env, GetThreadPoolSize, "getThreadPoolSize");
 
     return exports;
 }
 
-NODE_API_MODULE(pixels, Init);
+// Context aware registration, so the addon can be loaded by the main thread and any number of worker threads.
+NAPI_MODULE_INIT() {
+    try {
+        return Init(Env(env), Object(env, exports));
+    } catch (const Error& e) {
+        e.ThrowAsJavaScriptException();
+        return nullptr;
+    }
+}
@@ -7,12 +7,15 @@
 
 #include "Pipeline.h"
 
-#include <set>
-
-#include "napi-thread-safe-callback.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
 #include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
 
 #define NANOSVG_ALL_COLOR_KEYWORDS
 #define NANOSVG_IMPLEMENTATION
@@ -21,14 +24,39 @@
 #define NANOSVGRAST_IMPLEMENTATION
 #include "nanosvgrast.h"
 
+// stb_image allocates and frees its working memory, such as zlib output and JPEG component planes, during every
+// decode. The blocks are recycled through the calling thread's DecodeMemory.
+void *DecodeAlloc(size_t size);
+void *DecodeRealloc(void *ptr, size_t size);
+void DecodeFree(void *ptr);
+
+#define STBI_MALLOC(size) DecodeAlloc(size)
+#define STBI_REALLOC(ptr, size) DecodeRealloc(ptr, size)
+#define STBI_FREE(ptr) DecodeFree(ptr)
 #define STBI_FAILURE_USERMSG
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+// stb_image_resize asks for all of its working memory at the start of each resize and frees it at the end. The alloc
+// context is the calling thread's ScratchMemory.
+void *ScratchAlloc(size_t size, void *context);
+void ScratchFree(void *ptr, void *context);
+
+// The contributor and coefficient tables for each axis only depend on the filter and the sizes being resized between,
+// so they are computed once and copied from a cache on later resizes.
+void CalculateFilters(void *contributors, float *coefficients, int filter, float scale, float shift, int inputSize,
+    int outputSize);
+
+#define STBIR_MALLOC(size, context) ScratchAlloc(size, context)
+#define STBIR_FREE(ptr, context) ScratchFree(ptr, context)
+#define STBIR_CALCULATE_FILTERS CalculateFilters
 #define STB_IMAGE_RESIZE_IMPLEMENTATION
 #include "stb_image_resize.h"
 
 #include "Threads.h"
+#include "Addon.h"
+#include "Resample.h"
+#include "Atlas.h"
 
 using namespace Napi;
 
@@ -38,31 +66,107 @@ using namespace Napi;
 #define HEADER_HEIGHT "height"
 #define HEADER_CHANNELS "channels"
 #define HEADER_FORMAT "format"
+#define HEADER_OFFSET "offset"
+#define HEADER_STRIDE "stride"
+#define HEADER_FRAME "frame"
+#define HEADER_DELAY "delay"
+#define HEADER_FRAMES "frames"
+#define HEADER_LAYOUT "layout"
+#define HEADER_DTYPE "dtype"
+#define HEADER_OFFSETS "offsets"
+#define HEADER_INDEX "index"
 #define HEADER_EVENT_TYPE "header"
 
-#define ERROR_MESSAGE "message"
 #define ERROR_EVENT_TYPE "error"
 
 #define BUFFER_HEADER "header"
 #define BUFFER_EVENT_TYPE "data"
 #define BUFFER_RELEASE "release"
 
+#define ALLOCATION_EVENT_TYPE "allocation"
+
+#define ATLAS_PAGES "pages"
+#define ATLAS_FRAMES "frames"
+#define ATLAS_MAX_SIZE "maxSize"
+#define ATLAS_PADDING "padding"
+#define ATLAS_TRIM "trim"
+#define ATLAS_FORMAT "format"
+
+#define FRAME_PAGE "page"
+#define FRAME_X "x"
+#define FRAME_Y "y"
+#define FRAME_WIDTH "width"
+#define FRAME_HEIGHT "height"
+#define FRAME_U0 "u0"
+#define FRAME_V0 "v0"
+#define FRAME_U1 "u1"
+#define FRAME_V1 "v1"
+#define FRAME_TRIM_X "trimX"
+#define FRAME_TRIM_Y "trimY"
+#define FRAME_SOURCE_WIDTH "sourceWidth"
+#define FRAME_SOURCE_HEIGHT "sourceHeight"
+
+#define TARGET_VIEW "target"
+#define TARGET_OFFSET "offset"
+#define TARGET_STRIDE "stride"
+#define TARGET_INDEX "index"
+
+#define REQUEST_OUTPUT_TYPE "output"
 #define REQUEST_OUTPUT "outputOptions"
 #define REQUEST_FORMAT "format"
+#define REQUEST_SHARED "shared"
+#define REQUEST_PREMULTIPLIED "premultiplied"
+#define REQUEST_LAYOUT "layout"
+#define REQUEST_DTYPE "dtype"
+#define REQUEST_MEAN "mean"
+#define REQUEST_STD "std"
 #define REQUEST_SOURCE "source"
 #define REQUEST_WIDTH "resizeWidth"
 #define REQUEST_HEIGHT "resizeHeight"
 #define REQUEST_FILTER "resizeFilter"
+#define REQUEST_ENGINE "resizeEngine"
+#define REQUEST_STRATEGY "resizeStrategy"
 #define REQUEST_CONSTRAINT "resizeConstraint"
 #define REQUEST_DISABLE_DECODER_SCALING "resizeDisableDecoderScaling"
 #define REQUEST_IGNORE_ASPECT_RATIO "resizeIgnoreAspectRatio"
+#define REQUEST_OUTPUTS "outputs"
+#define REQUEST_OUTPUT_WIDTH "width"
+#define REQUEST_OUTPUT_HEIGHT "height"
+#define REQUEST_CASCADE "outputCascade"
+#define REQUEST_BATCH "batch"
+#define REQUEST_GRAVITY "resizeGravity"
+#define REQUEST_BACKGROUND "resizeBackground"
+#define REQUEST_CROP_X "cropX"
+#define REQUEST_CROP_Y "cropY"
+#define REQUEST_CROP_WIDTH "cropWidth"
+#define REQUEST_CROP_HEIGHT "cropHeight"
 
 #define FILTER_BOX "box"
 #define FILTER_TENT "tent"
 #define FILTER_GAUSSIAN "gaussian"
+#define FILTER_NEAREST "nearest"
+
+#define ENGINE_FIXED "fixed"
+
+#define STRATEGY_FAST "fast"
 
 #define CONSTRAINT_CONTAIN "contain"
 #define CONSTRAINT_FIT "fit"
+#define CONSTRAINT_COVER "cover"
+#define CONSTRAINT_PAD "pad"
+
+#define OUTPUT_TENSOR "tensor"
+
+#define LAYOUT_NCHW "nchw"
+#define LAYOUT_NHWC "nhwc"
+
+#define DTYPE_FLOAT32 "float32"
+#define DTYPE_UINT8 "uint8"
+
+#define GRAVITY_NORTH "north"
+#define GRAVITY_SOUTH "south"
+#define GRAVITY_EAST "east"
+#define GRAVITY_WEST "west"
 
 enum PixelFormat {
     PIXEL_FORMAT_RGBA = 0,
@@ -73,34 +177,345 @@ enum PixelFormat {
     PIXEL_FORMAT_UNKNOWN = -1
 };
 
-static std::set<void *> sBufferAllocations;
+enum ResizeConstraint {
+    RESIZE_CONSTRAINT_CONTAIN,
+    RESIZE_CONSTRAINT_FIT,
+    RESIZE_CONSTRAINT_COVER,
+    RESIZE_CONSTRAINT_PAD
+};
+
+enum ResizeEngine {
+    RESIZE_ENGINE_FLOAT,
+    RESIZE_ENGINE_FIXED
+};
 
 // Exported Functions
 
-void LoadPipeline(const CallbackInfo& info);
+Value LoadPipeline(const CallbackInfo& info);
 Value LoadPipelineSync(const CallbackInfo& info);
+Value CompilePipeline(const CallbackInfo& info);
+Value LoadPipelines(const CallbackInfo& info);
+Value LoadAtlas(const CallbackInfo& info);
+Value LoadAtlasSync(const CallbackInfo& info);
 
 // Internal Functions
 
 class ImageSource;
 class Request;
 class Result;
+class Target;
+class Job;
+class BulkJob;
+class Canvas;
 
 std::string PixelFormatToString(const PixelFormat pixelFormat);
 PixelFormat PixelFormatFromString(const std::string& str);
+stbir_filter FilterFromString(const std::string& str);
+ResizeConstraint ConstraintFromString(const std::string& str);
+ResizeEngine EngineFromString(const std::string& str);
 int GetChannels(const PixelFormat pixelFormat);
 int IsBigEndian();
-bool CompletionFunction(const Value& val);
 PixelFormat GetPixelFormatFromComponent(int component);
 void ConvertPixelsLE(unsigned char *bytes, int len, int bytesPerPixel, PixelFormat format);
 void ConvertPixelsBE(unsigned char *bytes, int len, int bytesPerPixel, PixelFormat format);
-std::shared_ptr<Result> Pipeline(const std::shared_ptr<Request> request, const std::shared_ptr<ImageSource> imageSource);
+void ConvertRows(unsigned char *pixels, int width, int height, size_t stride, int bytesPerPixel, PixelFormat format);
+void GetChannelOffsets(PixelFormat format, int offsets[4]);
+void CopyRows(const unsigned char *source, size_t sourceStride, unsigned char *dest, size_t destStride, size_t rowSize, int height);
+void FillRows(unsigned char *pixels, int width, int height, size_t stride, const unsigned char *color);
+float GravityFactor(const std::string& gravity, const char *start, const char *end);
+void WriteTensor(const std::shared_ptr<Request> request, const unsigned char *pixels, int width, int height, size_t stride,
+    unsigned char *output);
+bool ResizePixels(const unsigned char *pixels, const int width, const int height, const size_t stride,
+    const std::shared_ptr<Canvas> canvas, unsigned char *output, const size_t outputStride, const int channels);
+bool ResizePixelsFixed(const unsigned char *pixels, const int width, const int height, const size_t stride,
+    const std::shared_ptr<Canvas> canvas, unsigned char *output, const size_t outputStride);
+bool ResizePixelsFast(const unsigned char *pixels, const int width, const int height, const size_t stride,
+    const std::shared_ptr<Canvas> canvas, unsigned char *output, const size_t outputStride);
+std::shared_ptr<Result> Pipeline(const std::shared_ptr<Request> request, const std::shared_ptr<ImageSource> imageSource,
+    const std::shared_ptr<Target> target);
+std::shared_ptr<Result> PipelineFrame(const std::shared_ptr<Request> request, const std::shared_ptr<ImageSource> imageSource,
+    const std::shared_ptr<Canvas> canvas);
+std::shared_ptr<Result> PipelineSizes(const std::shared_ptr<Request> request, const std::shared_ptr<ImageSource> imageSource);
+std::shared_ptr<Result> PipelineBatch(const std::shared_ptr<Request> request, const std::shared_ptr<ImageSource> imageSource);
+std::shared_ptr<Request> NewRequest(const CallbackInfo& info);
+Value NewSharedBuffer(Env env, size_t size);
+void RunJob(const std::shared_ptr<Job> job);
 float ScaleFactor(const int source, const int dest);
-void AddBufferAllocation(void *bufferData);
-void ReleaseBufferAllocation(void *bufferData);
+float AspectScale(const ResizeConstraint constraint, const int sourceWidth, const int sourceHeight, const int destWidth,
+    const int destHeight);
+void AddBufferAllocation(Env env, void *bufferData);
+void ReleaseBufferAllocation(Env env, void *bufferData);
 
 // Internal Classes
 
+// A block of working memory kept by each thread and reused by every resize on it, so resizes neither contend for the
+// allocator nor fault in fresh pages each time. Requests larger than the retention limit are allocated and freed as
+// usual, so one huge resize does not pin its memory to the thread.
+class ScratchMemory {
+    private:
+        void *data;
+        size_t size;
+        bool inUse;
+
+        static const size_t MAX_RETAINED = 32*1024*1024;
+
+    public:
+        ScratchMemory() {
+            this->data = nullptr;
+            this->size = 0;
+            this->inUse = false;
+        }
+
+        ~ScratchMemory() {
+            free(this->data);
+        }
+
+        void *Alloc(const size_t size) {
+            if (this->inUse || size > MAX_RETAINED) {
+                return malloc(size);
+            }
+
+            if (size > this->size) {
+                free(this->data);
+                this->data = malloc(size);
+                this->size = this->data ? size : 0;
+            }
+
+            this->inUse = this->data != nullptr;
+
+            return this->data;
+        }
+
+        void Free(void *ptr) {
+            if (ptr != nullptr && ptr == this->data) {
+                this->inUse = false;
+            } else {
+                free(ptr);
+            }
+        }
+
+        static ScratchMemory *ForThread() {
+            static thread_local ScratchMemory scratch;
+
+            return &scratch;
+        }
+};
+
+// Blocks stb_image freed on this thread, kept for the next decode to allocate from instead of asking the allocator for
+// fresh pages. Every block is an ordinary malloc() block, so the decoded image a load keeps can be handed to the caller
+// and freed with free() like any other.
+//
+// Live blocks are tracked by address, to know their size when they come back. Tracking is dropped for the decoded
+// image once the load takes it over, and for everything else at the end of each Pipeline() call, after which a block
+// that comes back is just freed.
+class DecodeMemory {
+    private:
+        struct Block {
+            void *ptr;
+            size_t size;
+        };
+
+        std::vector<Block> live;
+        std::vector<Block> idle;
+        size_t idleSize;
+
+        static const size_t MAX_RETAINED = 64*1024*1024;
+
+        // Removes the block at ptr from blocks, returning its size, or 0 when it is not there.
+        static size_t Remove(std::vector<Block>& blocks, void *ptr) {
+            for (size_t i = 0; i < blocks.size(); i++) {
+                if (blocks[i].ptr == ptr) {
+                    auto size = blocks[i].size;
+
+                    blocks[i] = blocks.back();
+                    blocks.pop_back();
+
+                    return size;
+                }
+            }
+
+            return 0;
+        }
+
+    public:
+        DecodeMemory() {
+            this->idleSize = 0;
+        }
+
+        ~DecodeMemory() {
+            for (auto& block : this->idle) {
+                free(block.ptr);
+            }
+        }
+
+        void *Alloc(const size_t size) {
+            // The smallest idle block that fits, as long as it is not more than twice as large.
+            auto best = this->idle.size();
+
+            for (size_t i = 0; i < this->idle.size(); i++) {
+                if (this->idle[i].size >= size && this->idle[i].size / 2 <= size
+                        && (best == this->idle.size() || this->idle[i].size < this->idle[best].size)) {
+                    best = i;
+                }
+            }
+
+            Block block;
+
+            if (best < this->idle.size()) {
+                block = this->idle[best];
+                this->idleSize -= block.size;
+                this->idle[best] = this->idle.back();
+                this->idle.pop_back();
+            } else {
+                block.ptr = malloc(size);
+                block.size = size;
+
+                if (block.ptr == nullptr) {
+                    return nullptr;
+                }
+            }
+
+            this->live.push_back(block);
+
+            return block.ptr;
+        }
+
+        void *Realloc(void *ptr, const size_t size) {
+            if (ptr == nullptr) {
+                return this->Alloc(size);
+            }
+
+            for (auto& block : this->live) {
+                if (block.ptr == ptr) {
+                    if (block.size < size) {
+                        auto grown = realloc(ptr, size);
+
+                        if (grown == nullptr) {
+                            return nullptr;
+                        }
+
+                        block.ptr = grown;
+                        block.size = size;
+                    }
+
+                    return block.ptr;
+                }
+            }
+
+            return realloc(ptr, size);
+        }
+
+        void Free(void *ptr) {
+            auto size = Remove(this->live, ptr);
+
+            if (size == 0 || this->idleSize + size > MAX_RETAINED) {
+                free(ptr);
+            } else {
+                this->idle.push_back({ ptr, size });
+                this->idleSize += size;
+            }
+        }
+
+        // Hands a block over to the caller, who frees it with free().
+        void Keep(void *ptr) {
+            Remove(this->live, ptr);
+        }
+
+        // Forgets the blocks still live, which now belong to decoding state that outlives the call, such as a GIF's
+        // composite. The idle blocks stay for the next call.
+        void Reset() {
+            this->live.clear();
+        }
+
+        static DecodeMemory *ForThread() {
+            static thread_local DecodeMemory memory;
+
+            return &memory;
+        }
+
+        // Resets the thread's decode memory when it goes out of scope.
+        class Scope {
+            public:
+                ~Scope() {
+                    DecodeMemory::ForThread()->Reset();
+                }
+        };
+};
+
+// Filter tables for one axis of a resize, shared read only by every thread that resizes between the same sizes. The
+// cache is cleared when it fills up; tables still being copied stay alive through their shared_ptr.
+class FilterTables {
+    private:
+        std::vector<unsigned char> contributors;
+        std::vector<float> coefficients;
+
+        typedef std::tuple<int, float, float, int, int> Key;
+
+        static const size_t MAX_ENTRIES = 256;
+
+        static std::mutex mutex;
+        static std::map<Key, std::shared_ptr<const FilterTables>> cache;
+
+    public:
+        FilterTables(const void *contributors, const size_t contributorsSize, const float *coefficients,
+                const size_t coefficientsCount) {
+            auto c = static_cast<const unsigned char *>(contributors);
+
+            this->contributors.assign(c, c + contributorsSize);
+            this->coefficients.assign(coefficients, coefficients + coefficientsCount);
+        }
+
+        void CopyTo(void *contributors, float *coefficients) const {
+            memcpy(contributors, this->contributors.data(), this->contributors.size());
+            memcpy(coefficients, this->coefficients.data(), this->coefficients.size()*sizeof(float));
+        }
+
+        static std::shared_ptr<const FilterTables> Find(const int filter, const float scale, const float shift,
+                const int inputSize, const int outputSize) {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = cache.find(Key(filter, scale, shift, inputSize, outputSize));
+
+            return it == cache.end() ? nullptr : it->second;
+        }
+
+        static void Add(const int filter, const float scale, const float shift, const int inputSize,
+                const int outputSize, std::shared_ptr<const FilterTables> tables) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (cache.size() >= MAX_ENTRIES) {
+                cache.clear();
+            }
+
+            cache[Key(filter, scale, shift, inputSize, outputSize)] = tables;
+        }
+};
+
+std::mutex FilterTables::mutex;
+std::map<FilterTables::Key, std::shared_ptr<const FilterTables>> FilterTables::cache;
+
+// One javascript buffer's hold on result memory, dropped once by release() or by the garbage collector, whichever comes
+// first. Loads coalesced into one job hand each caller a buffer of its own over the same memory, which is freed when
+// the last of them lets go.
+class BufferReference {
+    private:
+        void *data;
+        bool released;
+
+    public:
+        BufferReference(Env env, void *data) {
+            this->data = data;
+            this->released = false;
+            AddBufferAllocation(env, data);
+        }
+
+        void Release(Env env) {
+            if (!this->released) {
+                this->released = true;
+                ReleaseBufferAllocation(env, this->data);
+            }
+        }
+};
+
 class ImageSource {
     private:
         FILE *file;
@@ -112,12 +527,25 @@ class ImageSource {
         int height;
         int channels;
 
+        // Frame decoding state. A GIF is composited frame by frame in gif->out, and a frame can be disposed back to
+        // the composite two frames earlier, so the last two are kept.
+        stbi__context *context;
+        stbi__gif *gif;
+        unsigned char *still;
+        unsigned char *composites[2];
+        int frameCount;
+
     public:
         ImageSource(const std::string& filename) {
             this->filename = filename;
             this->file = nullptr;
             this->svg = nullptr;
             this->width = this->height = this->channels = 0;
+            this->context = nullptr;
+            this->gif = nullptr;
+            this->still = nullptr;
+            this->composites[0] = this->composites[1] = nullptr;
+            this->frameCount = 0;
         }
 
         bool Open() {
@@ -173,6 +601,105 @@ class ImageSource {
                 nsvgDelete(this->svg);
                 this->svg = nullptr;
             }
+
+            if (this->gif) {
+                STBI_FREE(this->gif->out);
+                STBI_FREE(this->gif->background);
+                STBI_FREE(this->gif->history);
+                free(this->gif);
+                this->gif = nullptr;
+            }
+
+            free(this->context);
+            this->context = nullptr;
+            stbi_image_free(this->still);
+            this->still = nullptr;
+            free(this->composites[0]);
+            free(this->composites[1]);
+            this->composites[0] = this->composites[1] = nullptr;
+        }
+
+        // Decodes the next frame, as RGBA at the source size. Each frame of a GIF is composited over the ones before
+        // it. Other raster images have a single frame. Returns nullptr after the last frame, or on error with
+        // GetError() set. The frame is owned by the source and valid until the next call.
+        const unsigned char *NextFrame(int *delay) {
+            auto frameSize = (size_t)this->width*this->height*4;
+            int components;
+
+            *delay = 0;
+
+            if (this->context == nullptr) {
+                this->context = (stbi__context *)malloc(sizeof(stbi__context));
+
+                if (this->context == nullptr) {
+                    this->error = "Failed to allocate memory for frame decoding.";
+                    return nullptr;
+                }
+
+                stbi__start_file(this->context, this->file);
+
+                if (stbi__gif_test(this->context)) {
+                    this->gif = (stbi__gif *)calloc(1, sizeof(stbi__gif));
+
+                    if (this->gif == nullptr) {
+                        this->error = "Failed to allocate memory for frame decoding.";
+                        return nullptr;
+                    }
+                }
+            }
+
+            if (this->gif == nullptr) {
+                if (this->frameCount > 0) {
+                    return nullptr;
+                }
+
+                int width;
+                int height;
+
+                this->still = stbi__load_and_postprocess_8bit(this->context, &width, &height, &components, 4);
+
+                if (this->still == nullptr) {
+                    this->error = std::string("File load error: ").append(stbi_failure_reason());
+                    return nullptr;
+                }
+
+                this->frameCount++;
+                return this->still;
+            }
+
+            auto twoBack = (this->frameCount >= 2) ? this->composites[this->frameCount % 2] : nullptr;
+            auto frame = stbi__gif_load_next(this->context, this->gif, &components, 4, twoBack);
+
+            if (frame == (stbi_uc *)this->context) {
+                // end of animation marker
+                return nullptr;
+            }
+
+            if (frame == nullptr) {
+                this->error = std::string("File load error: ").append(stbi_failure_reason());
+                return nullptr;
+            }
+
+            auto composite = this->composites[this->frameCount % 2];
+
+            if (composite == nullptr) {
+                composite = this->composites[this->frameCount % 2] = (unsigned char *)malloc(frameSize);
+
+                if (composite == nullptr) {
+                    this->error = "Failed to allocate memory for frame decoding.";
+                    return nullptr;
+                }
+            }
+
+            memcpy(composite, frame, frameSize);
+            *delay = this->gif->delay;
+            this->frameCount++;
+
+            return frame;
+        }
+
+        int GetFrameCount() const {
+            return this->frameCount;
         }
 
         bool IsLoaded() const {
@@ -206,8 +733,136 @@ class ImageSource {
         FILE *GetFile() const {
             return this->file;
         }
+
+        const std::string& GetFilename() const {
+            return this->filename;
+        }
+};
+
+// A raster decode shared by the loads of one file that run at the same time, so the file is decoded once and each load
+// only resizes it. The pixels are freed with the last load holding the decode.
+class SharedDecode {
+    private:
+        std::mutex mutex;
+        std::condition_variable ready;
+        bool done;
+        unsigned char *pixels;
+        int width;
+        int height;
+        std::string error;
+
+        // Loads of the same file that ask for different channel orders or rows decode it separately.
+        typedef std::tuple<std::string, PixelFormat, int, int> Key;
+
+        static std::mutex decodesMutex;
+        static std::map<Key, std::shared_ptr<SharedDecode>> decodes;
+
+    public:
+        SharedDecode() {
+            this->done = false;
+            this->pixels = nullptr;
+            this->width = this->height = 0;
+        }
+
+        ~SharedDecode() {
+            stbi_image_free(this->pixels);
+        }
+
+        // Decodes the source as RGBA, or waits for the load on another thread that is already decoding the same file.
+        // With a pixel format other than PIXEL_FORMAT_UNKNOWN, the decoder writes the channels in that format instead,
+        // so the pixels need no conversion afterwards. A bottom other than 0 stops the decode after row bottom - 1 where
+        // the format allows, so the pixels may be only bottom rows tall, with the rows above top left undefined.
+        static std::shared_ptr<SharedDecode> Decode(const std::shared_ptr<ImageSource> imageSource,
+                const PixelFormat format, const int top, const int bottom) {
+            std::shared_ptr<SharedDecode> decode;
+            auto key = Key(imageSource->GetFilename(), format, top, bottom);
+            auto joined = false;
+
+            {
+                std::lock_guard<std::mutex> lock(decodesMutex);
+                auto it = decodes.find(key);
+
+                if (it != decodes.end()) {
+                    decode = it->second;
+                    joined = true;
+                } else {
+                    decode = decodes[key] = std::shared_ptr<SharedDecode>(new SharedDecode());
+                }
+            }
+
+            if (joined) {
+                std::unique_lock<std::mutex> lock(decode->mutex);
+
+                decode->ready.wait(lock, [&decode]() { return decode->done; });
+
+                return decode;
+            }
+
+            int components;
+            int offsets[4];
+
+            GetChannelOffsets(format, offsets);
+            stbi_set_channel_order_thread(offsets[0], offsets[1], offsets[2], offsets[3]);
+            stbi_set_row_range_thread(top, bottom);
+
+            auto pixels = stbi_load_from_file(imageSource->GetFile(), &decode->width, &decode->height, &components, 4);
+
+            // Other decodes on this thread, such as animation frames, expect every row in RGBA.
+            stbi_set_channel_order_thread(0, 1, 2, 3);
+            stbi_set_row_range_thread(0, 0);
+            DecodeMemory::ForThread()->Keep(pixels);
+
+            {
+                std::lock_guard<std::mutex> lock(decodesMutex);
+
+                decodes.erase(key);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(decode->mutex);
+
+                decode->pixels = pixels;
+                decode->done = true;
+
+                if (pixels == nullptr) {
+                    decode->error = std::string("File load error: ").append(stbi_failure_reason());
+                }
+            }
+
+            decode->ready.notify_all();
+
+            return decode;
+        }
+
+        // Hands the pixels over to the caller, who then frees them. Only valid when no other load holds the decode.
+        unsigned char *Take() {
+            auto pixels = this->pixels;
+
+            this->pixels = nullptr;
+
+            return pixels;
+        }
+
+        const unsigned char *GetPixels() const {
+            return this->pixels;
+        }
+
+        int GetWidth() const {
+            return this->width;
+        }
+
+        int GetHeight() const {
+            return this->height;
+        }
+
+        const std::string& GetError() const {
+            return this->error;
+        }
 };
 
+std::mutex SharedDecode::decodesMutex;
+std::map<SharedDecode::Key, std::shared_ptr<SharedDecode>> SharedDecode::decodes;
+
 class Result {
 private:
     bool final;
@@ -225,6 +880,10 @@ public:
 
     virtual std::string GetType() const = 0;
 
+    // Frees what the result holds when it will never be delivered.
+    virtual void Discard() {
+    }
+
     bool IsFinal() const {
         return this->final;
     }
@@ -240,11 +899,7 @@ class ErrorResult : public Result {
         }
 
         Value ToValue(Env env) const {
-           Object obj = Napi::Object::New(env);
-
-           obj[ERROR_MESSAGE] = String::New(env, this->error);
-
-           return obj;
+           return Error::New(env, this->error).Value();
         }
 
         std::string GetError() const {
@@ -269,6 +924,14 @@ class HeaderResult : public Result {
             this->channels = channels;
         }
 
+        int GetWidth() const {
+            return this->width;
+        }
+
+        int GetHeight() const {
+            return this->height;
+        }
+
         Value ToValue(Env env) const {
             auto header = Object::New(env);
 
@@ -290,581 +953,3033 @@ class BufferResult : public HeaderResult {
         unsigned char * pixels;
 
     public:
-        BufferResult(const int width, const int height, const int channels, const PixelFormat format, unsigned char * pixels)
-                : HeaderResult(width, height, channels, true) {
+        BufferResult(const int width, const int height, const int channels, const PixelFormat format, unsigned char * pixels,
+                const bool final = true) : HeaderResult(width, height, channels, final) {
             this->format = format;
             this->pixels = pixels;
         }
 
+        const unsigned char *GetPixels() const {
+            return this->pixels;
+        }
+
         Value ToValue(Env env) const {
             auto header = HeaderResult::ToValue(env).As<Object>();
 
             header[HEADER_FORMAT] = String::New(env, PixelFormatToString(this->format));
 
-            auto bufferData = static_cast<void *>(this->pixels);
-
-            AddBufferAllocation(bufferData);
-
+            auto reference = std::shared_ptr<BufferReference>(new BufferReference(env, this->pixels));
             auto buffer = Napi::Buffer<unsigned char>::New(
                  env,
                  this->pixels,
                  this->width*this->height*this->channels,
-                 [](Env env, void* bufferData) {
-                     ReleaseBufferAllocation(bufferData);
+                 [reference](Env env, void *) {
+                     reference->Release(env);
                  }
             );
 
             buffer.Set(BUFFER_HEADER, header);
-            buffer.Set(BUFFER_RELEASE, Function::New(env, [bufferData](const CallbackInfo& callbackInfo) {
-                ReleaseBufferAllocation(bufferData);
+            buffer.Set(BUFFER_RELEASE, Function::New(env, [reference](const CallbackInfo& callbackInfo) {
+                reference->Release(callbackInfo.Env());
             }));
             return buffer;
         }
 
+        void Discard() {
+            free(this->pixels);
+            this->pixels = nullptr;
+        }
+
         std::string GetType() const {
             return BUFFER_EVENT_TYPE;
         }
 };
 
-class Request {
+// The outputs of a multi-size request, in request order.
+class BuffersResult : public Result {
     private:
-        std::string filename;
-        PixelFormat format;
-        bool isHeaderQuery;
-
-        int width;
-        int height;
-        std::string filter;
-        std::string constraint;
-        bool disableDecoderScaling;
-        bool ignoreAspectRatio;
+        std::vector<std::shared_ptr<BufferResult>> buffers;
 
     public:
-        Request(const CallbackInfo& info) {
-            // Assume arguments are validated in javascript.
-            auto request = info[0].As<Object>();
-            auto format = request.Get(REQUEST_OUTPUT).As<Object>().Get(REQUEST_FORMAT).As<String>().Utf8Value();
-
-            this->filename = request.Get(REQUEST_SOURCE).As<String>().Utf8Value();
-            this->format = PixelFormatFromString(format);
-            this->width = request.Get(REQUEST_WIDTH).As<Number>().Int32Value();
-            this->height = request.Get(REQUEST_HEIGHT).As<Number>().Int32Value();
-            this->filter = request.Get(REQUEST_FILTER).As<String>().Utf8Value();
-            this->constraint = request.Get(REQUEST_CONSTRAINT).As<String>().Utf8Value();
-            this->disableDecoderScaling = request.Get(REQUEST_DISABLE_DECODER_SCALING).As<Boolean>().Value();
-            this->ignoreAspectRatio = request.Get(REQUEST_IGNORE_ASPECT_RATIO).As<Boolean>().Value();
-
-            this->isHeaderQuery = info[1].As<Boolean>().Value();
+        BuffersResult(const std::vector<std::shared_ptr<BufferResult>>& buffers) : Result(true) {
+            this->buffers = buffers;
         }
 
-        const std::string& GetFilename() const {
-            return this->filename;
+        Value ToValue(Env env) const {
+            auto array = Array::New(env, this->buffers.size());
+
+            for (size_t i = 0; i < this->buffers.size(); i++) {
+                array[i] = this->buffers[i]->ToValue(env);
+            }
+
+            return array;
         }
 
-        PixelFormat GetFormat() const {
-            return this->format;
+        void Discard() {
+            for (auto buffer : this->buffers) {
+                buffer->Discard();
+            }
         }
 
-        bool IsHeaderQuery() const {
-            return this->isHeaderQuery;
+        std::string GetType() const {
+            return BUFFER_EVENT_TYPE;
         }
+};
 
-        int GetWidth() const {
-            return this->width;
+// Images of the same size, one after the other in a single buffer, like the layers of a texture array.
+class BatchResult : public HeaderResult {
+    private:
+        PixelFormat format;
+        unsigned char *pixels;
+        int count;
+
+    public:
+        BatchResult(const int width, const int height, const int channels, const PixelFormat format, unsigned char *pixels,
+                const int count) : HeaderResult(width, height, channels, true) {
+            this->format = format;
+            this->pixels = pixels;
+            this->count = count;
         }
 
-        int GetHeight() const {
-            return this->height;
+        Value ToValue(Env env) const {
+            auto header = HeaderResult::ToValue(env).As<Object>();
+            auto imageSize = (size_t)this->width*this->height*this->channels;
+            auto offsets = Array::New(env, this->count);
+
+            for (auto i = 0; i < this->count; i++) {
+                offsets[i] = Number::New(env, i*imageSize);
+            }
+
+            header[HEADER_FORMAT] = String::New(env, PixelFormatToString(this->format));
+            header[HEADER_OFFSETS] = offsets;
+
+            auto reference = std::shared_ptr<BufferReference>(new BufferReference(env, this->pixels));
+            auto buffer = Napi::Buffer<unsigned char>::New(
+                 env,
+                 this->pixels,
+                 imageSize*this->count,
+                 [reference](Env env, void *) {
+                     reference->Release(env);
+                 }
+            );
+
+            buffer.Set(BUFFER_HEADER, header);
+            buffer.Set(BUFFER_RELEASE, Function::New(env, [reference](const CallbackInfo& callbackInfo) {
+                reference->Release(callbackInfo.Env());
+            }));
+            return buffer;
         }
 
-        const std::string& GetFilter() const {
-            return this->filter;
+        void Discard() {
+            free(this->pixels);
+            this->pixels = nullptr;
         }
 
-        const std::string& GetConstraint() const {
-            return this->constraint;
+        std::string GetType() const {
+            return BUFFER_EVENT_TYPE;
         }
+};
 
-        bool IsDisableDecoderScaling() const {
-            return this->disableDecoderScaling;
+// Where one image of an atlas was drawn, and the part of the image that was kept when trimmed.
+class AtlasFrame {
+    private:
+        AtlasRect rect;
+        int left;
+        int top;
+        int sourceWidth;
+        int sourceHeight;
+
+    public:
+        AtlasFrame(const AtlasRect& rect, const int left, const int top, const int sourceWidth, const int sourceHeight)
+                : rect(rect) {
+            this->left = left;
+            this->top = top;
+            this->sourceWidth = sourceWidth;
+            this->sourceHeight = sourceHeight;
         }
 
-        bool IsIgnoreAspectRatio() const {
-            return this->ignoreAspectRatio;
+        Value ToValue(Env env, const int pageWidth, const int pageHeight) const {
+            auto frame = Object::New(env);
+            auto x = this->rect.GetX();
+            auto y = this->rect.GetY();
+            auto width = this->rect.GetWidth();
+            auto height = this->rect.GetHeight();
+
+            frame[FRAME_PAGE] = Number::New(env, this->rect.GetPage());
+            frame[FRAME_X] = Number::New(env, x);
+            frame[FRAME_Y] = Number::New(env, y);
+            frame[FRAME_WIDTH] = Number::New(env, width);
+            frame[FRAME_HEIGHT] = Number::New(env, height);
+            frame[FRAME_U0] = Number::New(env, (double)x / pageWidth);
+            frame[FRAME_V0] = Number::New(env, (double)y / pageHeight);
+            frame[FRAME_U1] = Number::New(env, (double)(x + width) / pageWidth);
+            frame[FRAME_V1] = Number::New(env, (double)(y + height) / pageHeight);
+            frame[FRAME_TRIM_X] = Number::New(env, this->left);
+            frame[FRAME_TRIM_Y] = Number::New(env, this->top);
+            frame[FRAME_SOURCE_WIDTH] = Number::New(env, this->sourceWidth);
+            frame[FRAME_SOURCE_HEIGHT] = Number::New(env, this->sourceHeight);
+
+            return frame;
+        }
+
+        int GetPage() const {
+            return this->rect.GetPage();
         }
 };
 
-class Canvas {
+// The pages of a texture atlas, and a frame for each image in request order.
+class AtlasResult : public Result {
     private:
-        float scaleX;
-        float scaleY;
-        int width;
-        int height;
-        stbir_filter filter;
-        bool resize;
+        std::vector<std::shared_ptr<BufferResult>> pages;
+        std::vector<AtlasFrame> frames;
 
     public:
-        Canvas(const std::shared_ptr<Request> request, const int sourceWidth, const int sourceHeight) {
-            auto filter = request->GetFilter();
-
-            if (filter == FILTER_BOX) {
-                this->filter = STBIR_FILTER_BOX;
-            } else if (filter == FILTER_TENT) {
-                this->filter = STBIR_FILTER_TRIANGLE;
-            } else if (filter == FILTER_GAUSSIAN) {
-                this->filter = STBIR_FILTER_CUBICBSPLINE;
-            } else {
-                this->filter = STBIR_FILTER_DEFAULT;
+        AtlasResult(const std::vector<std::shared_ptr<BufferResult>>& pages, const std::vector<AtlasFrame>& frames)
+                : Result(true) {
+            this->pages = pages;
+            this->frames = frames;
+        }
+
+        Value ToValue(Env env) const {
+            auto atlas = Object::New(env);
+            auto pages = Array::New(env, this->pages.size());
+            auto frames = Array::New(env, this->frames.size());
+
+            for (size_t i = 0; i < this->pages.size(); i++) {
+                pages[i] = this->pages[i]->ToValue(env);
             }
 
-            auto destWidth = request->GetWidth();
-            auto destHeight = request->GetHeight();
+            for (size_t i = 0; i < this->frames.size(); i++) {
+                auto& page = this->pages[this->frames[i].GetPage()];
 
-            this->resize = (destWidth > 0 && destHeight > 0) && !(sourceWidth == destWidth && sourceHeight == destHeight);
+                frames[i] = this->frames[i].ToValue(env, page->GetWidth(), page->GetHeight());
+            }
 
-            // TODO: simplify if new constraints are added..
-            if (this->resize) {
-                if (request->GetConstraint() == "contain") {
-                    if (sourceWidth <= destWidth && sourceHeight <= destHeight) {
-                        // smaller than the bounding box. no resizing required.
-                        this->width = sourceWidth;
-                        this->height = sourceHeight;
-                        this->scaleX = 1;
-                        this->scaleY = 1;
-                        this->resize = false;
-                    } else if (request->IsIgnoreAspectRatio()) {
-                        if (sourceWidth < destWidth) {
-                            // width fits, squish height
-                            this->width = sourceWidth;
-                            this->height = destHeight;
-                            this->scaleX = 1;
-                            this->scaleY = ScaleFactor(sourceHeight, destHeight);
-                        } else if (sourceHeight < destHeight) {
-                            // height fits, squish width
-                            this->width = destWidth;
-                            this->height = sourceHeight;
-                            this->scaleX = ScaleFactor(sourceWidth, destWidth);
-                            this->scaleY = 1;
-                        }
-                        else {
-                            // squish both dimensions
-                            this->width = destWidth;
-                            this->height = destHeight;
-                            this->scaleX = ScaleFactor(sourceWidth, destWidth);
-                            this->scaleY = ScaleFactor(sourceHeight, destHeight);
-                        }
-                    } else {
-                        // scale by aspect ratio
-                        auto aspectRatio = (float)sourceWidth / (float)sourceHeight;
-
-                        if (sourceWidth == sourceHeight) {
-                            this->width = destWidth;
-                            this->height = destHeight;
-                        } else if (sourceWidth > sourceHeight) {
-                            this->height = (int)((float)(destWidth) / aspectRatio);
-                            this->width = destWidth;
-                        } else {
-                            this->height = destHeight;
-                            this->width = (int)((float)(destHeight) * aspectRatio);
-                        }
+            atlas[ATLAS_PAGES] = pages;
+            atlas[ATLAS_FRAMES] = frames;
 
-                        this->scaleX = ScaleFactor(sourceWidth, destWidth);
-                        this->scaleY = ScaleFactor(sourceHeight, destHeight);
-                    }
-                } else { // "fit"
-                    if (request->IsIgnoreAspectRatio()) {
-                        // stretch to fit
-                        this->width = destWidth;
-                        this->height = destHeight;
-                        this->scaleX = ScaleFactor(sourceWidth, destWidth);
-                        this->scaleY = ScaleFactor(sourceHeight, destHeight);
-                    } else {
-                        // scale by aspect ratio (same as contain..)
-                        auto aspectRatio = (float)sourceWidth / (float)sourceHeight;
-
-                        if (sourceWidth == sourceHeight) {
-                            this->width = destWidth;
-                            this->height = destHeight;
-                        } else if (sourceWidth > sourceHeight) {
-                            this->height = (int)((float)(destWidth) / aspectRatio);
-                            this->width = destWidth;
-                        } else {
-                            this->height = destHeight;
-                            this->width = (int)((float)(destHeight) * aspectRatio);
-                        }
+            return atlas;
+        }
 
-                        this->scaleX = ScaleFactor(sourceWidth, destWidth);
-                        this->scaleY = ScaleFactor(sourceHeight, destHeight);
-                    }
-                }
+        void Discard() {
+            for (auto page : this->pages) {
+                page->Discard();
+            }
+        }
+
+        std::string GetType() const {
+            return BUFFER_EVENT_TYPE;
+        }
+};
+
+// One frame of an animation. More frames, or the end of the animation, follow.
+class FrameResult : public BufferResult {
+    private:
+        int frame;
+        int delay;
+
+    public:
+        FrameResult(const int width, const int height, const int channels, const PixelFormat format, unsigned char * pixels,
+                const int frame, const int delay) : BufferResult(width, height, channels, format, pixels, false) {
+            this->frame = frame;
+            this->delay = delay;
+        }
+
+        Value ToValue(Env env) const {
+            auto buffer = BufferResult::ToValue(env).As<Object>();
+            auto header = buffer.Get(BUFFER_HEADER).As<Object>();
+
+            header[HEADER_FRAME] = Number::New(env, this->frame);
+            header[HEADER_DELAY] = Number::New(env, this->delay);
+
+            return buffer;
+        }
+};
+
+// Ends an animation, after its last frame.
+class AnimationResult : public HeaderResult {
+    private:
+        PixelFormat format;
+        int frames;
+
+    public:
+        AnimationResult(const int width, const int height, const int channels, const PixelFormat format, const int frames)
+                : HeaderResult(width, height, channels, true) {
+            this->format = format;
+            this->frames = frames;
+        }
+
+        Value ToValue(Env env) const {
+            auto header = HeaderResult::ToValue(env).As<Object>();
+
+            header[HEADER_FORMAT] = String::New(env, PixelFormatToString(this->format));
+            header[HEADER_FRAMES] = Number::New(env, this->frames);
+
+            return header;
+        }
+};
+
+// Memory owned by javascript that the final stage of the pipeline writes into, instead of allocating a new buffer.
+// Rows are written stride bytes apart, starting offset bytes into the memory. The view (a Uint8Array) is pinned with a
+// reference from Set() until Release(), both called on the main thread.
+class Target {
+    private:
+        unsigned char *data;
+        size_t length;
+        size_t offset;
+        size_t stride;
+        size_t index;
+        napi_ref ref;
+
+    public:
+        Target() {
+            this->data = nullptr;
+            this->length = 0;
+            this->offset = 0;
+            this->stride = 0;
+            this->index = 0;
+            this->ref = nullptr;
+        }
+
+        void Set(Env env, const Value& view, const size_t offset = 0, const size_t stride = 0, const size_t index = 0) {
+            auto array = view.As<Uint8Array>();
+
+            this->Release(env);
+
+            if (napi_create_reference(env, array, 1, &this->ref) != napi_ok) {
+                throw Error::New(env, "Failed to reference target buffer.");
+            }
+
+            this->data = array.Data();
+            this->length = array.ByteLength();
+            this->offset = offset;
+            this->stride = stride;
+            this->index = index;
+        }
+
+        // Memory owned by the pipeline, at an offset.
+        void Set(unsigned char *data, const size_t length, const size_t offset) {
+            this->data = data;
+            this->length = length;
+            this->offset = offset;
+            this->stride = 0;
+            this->index = 0;
+        }
+
+        // Assume arguments are validated in javascript.
+        void Set(Env env, const Object& options) {
+            this->Set(
+                env,
+                options.Get(TARGET_VIEW),
+                options.Get(TARGET_OFFSET).As<Number>().Int64Value(),
+                options.Get(TARGET_STRIDE).As<Number>().Int64Value(),
+                options.Get(TARGET_INDEX).As<Number>().Int64Value());
+        }
+
+        // The target holds a batch of images of the given size, one after the other from the offset. Moves the offset
+        // to the image at the index.
+        void Seek(const size_t imageSize) {
+            this->offset += this->index*imageSize;
+            this->index = 0;
+        }
+
+        void Release(Env env) {
+            if (this->ref) {
+                napi_delete_reference(env, this->ref);
+                this->ref = nullptr;
+                this->data = nullptr;
+                this->length = 0;
+            }
+        }
+
+        Value GetValue(Env env) const {
+            napi_value value;
+
+            if (napi_get_reference_value(env, this->ref, &value) != napi_ok) {
+                throw Error::New(env, "Failed to get target buffer.");
+            }
+
+            return Value(env, value);
+        }
+
+        bool IsSet() const {
+            return this->data != nullptr;
+        }
+
+        // First byte of the first row.
+        unsigned char *GetPixels() const {
+            return this->data + this->offset;
+        }
+
+        size_t GetOffset() const {
+            return this->offset;
+        }
+
+        // Row pitch. Rows are packed when no stride was given.
+        size_t GetStride(const size_t rowSize) const {
+            return this->stride ? this->stride : rowSize;
+        }
+
+        std::string Validate(const int width, const int height, const int channels) const {
+            auto rowSize = (size_t)width*channels;
+            auto stride = this->GetStride(rowSize);
+
+            if (stride < rowSize) {
+                return "Target stride is smaller than a row of the output image.";
+            }
+
+            if (this->offset > this->length || (height > 0 && (this->length - this->offset) < (height - 1)*stride + rowSize)) {
+                return "Target buffer is too small for the output image at the given offset and stride.";
+            }
+
+            return "";
+        }
+};
+
+class TargetResult : public HeaderResult {
+    private:
+        PixelFormat format;
+        std::shared_ptr<Target> target;
+
+    public:
+        TargetResult(const int width, const int height, const int channels, const PixelFormat format,
+                const std::shared_ptr<Target> target) : HeaderResult(width, height, channels, true) {
+            this->format = format;
+            this->target = target;
+        }
+
+        Value ToValue(Env env) const {
+            auto header = HeaderResult::ToValue(env).As<Object>();
+            auto view = this->target->GetValue(env).As<Object>();
+
+            header[HEADER_FORMAT] = String::New(env, PixelFormatToString(this->format));
+            header[HEADER_OFFSET] = Number::New(env, this->target->GetOffset());
+            header[HEADER_STRIDE] = Number::New(env, this->target->GetStride((size_t)this->width*this->channels));
+            view.Set(BUFFER_HEADER, header);
+
+            return view;
+        }
+
+        PixelFormat GetFormat() const {
+            return this->format;
+        }
+
+        std::string GetType() const {
+            return BUFFER_EVENT_TYPE;
+        }
+};
+
+// RGB pixels as a tensor of one image, either in memory of its own or written to a target.
+class TensorResult : public HeaderResult {
+    private:
+        std::string layout;
+        std::string dtype;
+        unsigned char *data;
+        size_t size;
+        std::shared_ptr<Target> target;
+
+    public:
+        TensorResult(const int width, const int height, const std::string& layout, const std::string& dtype,
+                unsigned char *data, const size_t size, const std::shared_ptr<Target> target) : HeaderResult(width, height, 3, true) {
+            this->layout = layout;
+            this->dtype = dtype;
+            this->data = data;
+            this->size = size;
+            this->target = target;
+        }
+
+        Value ToValue(Env env) const {
+            auto header = HeaderResult::ToValue(env).As<Object>();
+            Object array;
+
+            header[HEADER_FORMAT] = String::New(env, PixelFormatToString(PIXEL_FORMAT_RGB));
+            header[HEADER_LAYOUT] = String::New(env, this->layout);
+            header[HEADER_DTYPE] = String::New(env, this->dtype);
+
+            if (this->target->IsSet()) {
+                array = this->target->GetValue(env).As<Object>();
+                header[HEADER_OFFSET] = Number::New(env, this->target->GetOffset());
+                array.Set(BUFFER_HEADER, header);
+
+                return array;
+            }
+
+            auto reference = std::shared_ptr<BufferReference>(new BufferReference(env, this->data));
+            auto arrayBuffer = ArrayBuffer::New(env, this->data, this->size, [reference](Env env, void *) {
+                reference->Release(env);
+            });
+
+            if (this->dtype == DTYPE_FLOAT32) {
+                array = Float32Array::New(env, this->size / sizeof(float), arrayBuffer, 0);
             } else {
-                this->width = sourceWidth;
-                this->height = sourceHeight;
-                this->scaleX = 1;
-                this->scaleY = 1;
+                array = Uint8Array::New(env, this->size, arrayBuffer, 0);
             }
+
+            array.Set(BUFFER_HEADER, header);
+            array.Set(BUFFER_RELEASE, Function::New(env, [reference](const CallbackInfo& callbackInfo) {
+                reference->Release(callbackInfo.Env());
+            }));
+
+            return array;
         }
 
-        float GetScaleX() const {
-            return this->scaleX;
+        void Discard() {
+            if (!this->target->IsSet()) {
+                free(this->data);
+                this->data = nullptr;
+            }
         }
 
-        float GetScaleY() const {
-            return this->scaleY;
+        std::string GetType() const {
+            return BUFFER_EVENT_TYPE;
+        }
+};
+
+// The pipeline needs the main thread to allocate its output before it can continue.
+class AllocationResult : public HeaderResult {
+    private:
+        size_t size;
+
+    public:
+        AllocationResult(const int width, const int height, const int channels, const size_t size)
+                : HeaderResult(width, height, channels, false) {
+            this->size = size;
+        }
+
+        size_t GetSize() const {
+            return this->size;
+        }
+
+        std::string GetType() const {
+            return ALLOCATION_EVENT_TYPE;
+        }
+};
+
+// One entry of a multi-size request. The width and height are a resize bounding box, like Request's.
+class OutputSize {
+    private:
+        int width;
+        int height;
+        PixelFormat format;
+
+    public:
+        OutputSize(const int width, const int height, const PixelFormat format) {
+            this->width = width;
+            this->height = height;
+            this->format = format;
         }
 
         int GetWidth() const {
             return this->width;
         }
 
-        int GetHeight() const {
-            return this->height;
-        }
+        int GetHeight() const {
+            return this->height;
+        }
+
+        PixelFormat GetFormat() const {
+            return this->format;
+        }
+};
+
+class Request {
+    private:
+        std::string filename;
+        PixelFormat format;
+        bool shared;
+        bool premultiplied;
+        bool isHeaderQuery;
+        bool animation;
+
+        bool tensor;
+        std::string layout;
+        std::string dtype;
+        bool planar;
+        bool floatTensor;
+        float mean[3];
+        float std[3];
+
+        int width;
+        int height;
+        stbir_filter filter;
+        bool nearest;
+        ResizeConstraint constraint;
+        ResizeEngine engine;
+        bool fast;
+        float gravityX;
+        float gravityY;
+        unsigned char background[4];
+        bool disableDecoderScaling;
+        bool ignoreAspectRatio;
+
+        std::vector<OutputSize> outputs;
+        bool cascade;
+
+        std::vector<std::shared_ptr<Request>> batch;
+
+        int cropX;
+        int cropY;
+        int cropWidth;
+        int cropHeight;
+
+    public:
+        Request(const CallbackInfo& info)
+            : Request(info[0].As<Object>(), info[1].As<Boolean>().Value(), info[3].IsFunction()) {
+        }
+
+        // Assume arguments are validated in javascript.
+        Request(const Object& request, const bool isHeaderQuery, const bool animation) {
+            auto output = request.Get(REQUEST_OUTPUT).As<Object>();
+            auto format = output.Get(REQUEST_FORMAT).As<String>().Utf8Value();
+            auto shared = output.Get(REQUEST_SHARED);
+
+            this->filename = request.Get(REQUEST_SOURCE).As<String>().Utf8Value();
+            this->format = PixelFormatFromString(format);
+            this->tensor = request.Get(REQUEST_OUTPUT_TYPE).As<String>().Utf8Value() == OUTPUT_TENSOR;
+
+            this->planar = false;
+            this->floatTensor = false;
+            std::fill(this->mean, this->mean + 3, 0.f);
+            std::fill(this->std, this->std + 3, 1.f);
+
+            if (this->tensor) {
+                auto mean = output.Get(REQUEST_MEAN).As<Array>();
+                auto std = output.Get(REQUEST_STD).As<Array>();
+
+                this->layout = output.Get(REQUEST_LAYOUT).As<String>().Utf8Value();
+                this->dtype = output.Get(REQUEST_DTYPE).As<String>().Utf8Value();
+                this->planar = this->layout == LAYOUT_NCHW;
+                this->floatTensor = this->dtype == DTYPE_FLOAT32;
+
+                for (uint32_t i = 0; i < 3; i++) {
+                    this->mean[i] = mean.Get(i).As<Number>().FloatValue();
+                    this->std[i] = std.Get(i).As<Number>().FloatValue();
+                }
+            }
+
+            // A frame callback asks for every frame of the image, each in a buffer of its own.
+            this->animation = animation;
+            // A caller supplied SharedArrayBuffer arrives as the target argument, so only true means allocate one.
+            this->shared = !this->animation && shared.IsBoolean() && shared.As<Boolean>().Value();
+            this->premultiplied = output.Get(REQUEST_PREMULTIPLIED).ToBoolean();
+            this->width = request.Get(REQUEST_WIDTH).As<Number>().Int32Value();
+            this->height = request.Get(REQUEST_HEIGHT).As<Number>().Int32Value();
+            // Resolved once here, so neither a reused request nor the resize compares strings.
+            this->filter = FilterFromString(request.Get(REQUEST_FILTER).As<String>().Utf8Value());
+            this->nearest = request.Get(REQUEST_FILTER).As<String>().Utf8Value() == FILTER_NEAREST;
+            this->constraint = ConstraintFromString(request.Get(REQUEST_CONSTRAINT).As<String>().Utf8Value());
+            this->engine = EngineFromString(request.Get(REQUEST_ENGINE).As<String>().Utf8Value());
+            this->fast = request.Get(REQUEST_STRATEGY).As<String>().Utf8Value() == STRATEGY_FAST;
+
+            auto gravity = request.Get(REQUEST_GRAVITY).As<String>().Utf8Value();
+
+            this->gravityX = GravityFactor(gravity, GRAVITY_WEST, GRAVITY_EAST);
+            this->gravityY = GravityFactor(gravity, GRAVITY_NORTH, GRAVITY_SOUTH);
+
+            auto background = request.Get(REQUEST_BACKGROUND).As<Array>();
+
+            for (uint32_t i = 0; i < 4; i++) {
+                this->background[i] = (unsigned char)background.Get(i).As<Number>().Uint32Value();
+            }
+
+            // Padding is filled in the color space of the output.
+            if (this->premultiplied) {
+                PremultiplyRGBA8(this->background, 1, 1, 4, this->background, 4);
+            }
+            this->disableDecoderScaling = request.Get(REQUEST_DISABLE_DECODER_SCALING).As<Boolean>().Value();
+            this->ignoreAspectRatio = request.Get(REQUEST_IGNORE_ASPECT_RATIO).As<Boolean>().Value();
+            this->cascade = request.Get(REQUEST_CASCADE).ToBoolean();
+            this->cropX = request.Get(REQUEST_CROP_X).As<Number>().Int32Value();
+            this->cropY = request.Get(REQUEST_CROP_Y).As<Number>().Int32Value();
+            this->cropWidth = request.Get(REQUEST_CROP_WIDTH).As<Number>().Int32Value();
+            this->cropHeight = request.Get(REQUEST_CROP_HEIGHT).As<Number>().Int32Value();
+
+            auto outputs = request.Get(REQUEST_OUTPUTS);
+
+            if (outputs.IsArray()) {
+                auto array = outputs.As<Array>();
+
+                for (uint32_t i = 0; i < array.Length(); i++) {
+                    auto size = array.Get(i).As<Object>();
+
+                    this->outputs.push_back(OutputSize(
+                        size.Get(REQUEST_OUTPUT_WIDTH).As<Number>().Int32Value(),
+                        size.Get(REQUEST_OUTPUT_HEIGHT).As<Number>().Int32Value(),
+                        PixelFormatFromString(size.Get(REQUEST_FORMAT).As<String>().Utf8Value())));
+                }
+            }
+
+            auto batch = request.Get(REQUEST_BATCH);
+
+            if (batch.IsArray()) {
+                auto array = batch.As<Array>();
+
+                for (uint32_t i = 0; i < array.Length(); i++) {
+                    this->batch.push_back(std::shared_ptr<Request>(new Request(array.Get(i).As<Object>(), false, false)));
+                }
+            }
+
+            this->isHeaderQuery = isHeaderQuery;
+        }
+
+        const std::string& GetFilename() const {
+            return this->filename;
+        }
+
+        PixelFormat GetFormat() const {
+            return this->format;
+        }
+
+        bool IsShared() const {
+            return this->shared;
+        }
+
+        bool IsPremultiplied() const {
+            return this->premultiplied;
+        }
+
+        bool IsHeaderQuery() const {
+            return this->isHeaderQuery;
+        }
+
+        bool IsAnimation() const {
+            return this->animation;
+        }
+
+        bool IsTensor() const {
+            return this->tensor;
+        }
+
+        const std::string& GetLayout() const {
+            return this->layout;
+        }
+
+        const std::string& GetDtype() const {
+            return this->dtype;
+        }
+
+        const float *GetMean() const {
+            return this->mean;
+        }
+
+        const float *GetStd() const {
+            return this->std;
+        }
+
+        // Channels are stored as separate planes (nchw) rather than interleaved (nhwc).
+        bool IsPlanar() const {
+            return this->planar;
+        }
+
+        bool IsFloatTensor() const {
+            return this->floatTensor;
+        }
+
+        // Bytes of one pixel of a tensor.
+        int GetTensorPixelSize() const {
+            return 3*(this->floatTensor ? sizeof(float) : 1);
+        }
+
+        int GetWidth() const {
+            return this->width;
+        }
+
+        int GetHeight() const {
+            return this->height;
+        }
+
+        stbir_filter GetFilter() const {
+            return this->filter;
+        }
+
+        // Nearest neighbour sampling is not a stbir filter, so it is resolved on its own.
+        bool IsNearest() const {
+            return this->nearest;
+        }
+
+        ResizeEngine GetEngine() const {
+            return this->engine;
+        }
+
+        bool IsFast() const {
+            return this->fast;
+        }
+
+        ResizeConstraint GetConstraint() const {
+            return this->constraint;
+        }
+
+        // Where the gravity places the image horizontally: 0 for west, 0.5 for the middle and 1 for east.
+        float GetGravityX() const {
+            return this->gravityX;
+        }
+
+        // 0 for north, 0.5 for the middle and 1 for south.
+        float GetGravityY() const {
+            return this->gravityY;
+        }
+
+        // RGBA bytes.
+        const unsigned char *GetBackground() const {
+            return this->background;
+        }
+
+        bool IsDisableDecoderScaling() const {
+            return this->disableDecoderScaling;
+        }
+
+        bool IsIgnoreAspectRatio() const {
+            return this->ignoreAspectRatio;
+        }
+
+        bool IsMultiSize() const {
+            return !this->outputs.empty();
+        }
+
+        const std::vector<OutputSize>& GetOutputs() const {
+            return this->outputs;
+        }
+
+        bool IsCascade() const {
+            return this->cascade;
+        }
+
+        // Identifies the loads that produce the same result, so they can share one job. Empty for loads that deliver to
+        // a single caller, through frame callbacks or shared memory.
+        std::string GetKey() const {
+            std::string key;
+            auto add = [&key](const void *value, const size_t size) {
+                key.append(static_cast<const char *>(value), size);
+            };
+
+            if (this->animation || this->shared || this->IsBatch()) {
+                return key;
+            }
+
+            key.append(this->filename).push_back('\0');
+            add(&this->isHeaderQuery, sizeof(this->isHeaderQuery));
+            add(&this->format, sizeof(this->format));
+            add(&this->premultiplied, sizeof(this->premultiplied));
+            add(&this->tensor, sizeof(this->tensor));
+            add(&this->planar, sizeof(this->planar));
+            add(&this->floatTensor, sizeof(this->floatTensor));
+            add(this->mean, sizeof(this->mean));
+            add(this->std, sizeof(this->std));
+            add(&this->width, sizeof(this->width));
+            add(&this->height, sizeof(this->height));
+            add(&this->filter, sizeof(this->filter));
+            add(&this->nearest, sizeof(this->nearest));
+            add(&this->engine, sizeof(this->engine));
+            add(&this->fast, sizeof(this->fast));
+            add(&this->constraint, sizeof(this->constraint));
+            add(&this->gravityX, sizeof(this->gravityX));
+            add(&this->gravityY, sizeof(this->gravityY));
+            add(this->background, sizeof(this->background));
+            add(&this->disableDecoderScaling, sizeof(this->disableDecoderScaling));
+            add(&this->ignoreAspectRatio, sizeof(this->ignoreAspectRatio));
+            add(&this->cascade, sizeof(this->cascade));
+            add(&this->cropX, sizeof(this->cropX));
+            add(&this->cropY, sizeof(this->cropY));
+            add(&this->cropWidth, sizeof(this->cropWidth));
+            add(&this->cropHeight, sizeof(this->cropHeight));
+
+            for (auto& output : this->outputs) {
+                auto width = output.GetWidth();
+                auto height = output.GetHeight();
+                auto format = output.GetFormat();
+
+                add(&width, sizeof(width));
+                add(&height, sizeof(height));
+                add(&format, sizeof(format));
+            }
+
+            return key;
+        }
+
+        // A copy of this request that loads another source. Everything else is already resolved.
+        std::shared_ptr<Request> WithSource(const std::string& filename) const {
+            auto request = std::shared_ptr<Request>(new Request(*this));
+
+            request->filename = filename;
+
+            return request;
+        }
+
+        bool IsBatch() const {
+            return !this->batch.empty();
+        }
+
+        // The requests of every image in a batch. The first has the same source as this request.
+        const std::vector<std::shared_ptr<Request>>& GetBatch() const {
+            return this->batch;
+        }
+
+        bool IsCrop() const {
+            return this->cropWidth > 0 && this->cropHeight > 0;
+        }
+
+        int GetCropX() const {
+            return this->cropX;
+        }
+
+        int GetCropY() const {
+            return this->cropY;
+        }
+
+        // Width of the region of the source image the rest of the pipeline sees.
+        int GetCropWidth(const int sourceWidth) const {
+            return this->IsCrop() ? this->cropWidth : sourceWidth;
+        }
+
+        int GetCropHeight(const int sourceHeight) const {
+            return this->IsCrop() ? this->cropHeight : sourceHeight;
+        }
+
+        // Byte offset of the first pixel of the crop region in packed 4 channel source pixels.
+        size_t GetCropOffset(const int sourceWidth) const {
+            return this->IsCrop() ? ((size_t)this->cropY*sourceWidth + this->cropX)*4 : 0;
+        }
+};
+
+// State of a LoadPipeline() call. Created on the main thread and run on pool threads. Results travel back to the main
+// thread through the completion queue, either to settle the promise, to pass a frame to the frame callback or, for an
+// allocation, to resume the job.
+class Job {
+    public:
+        std::shared_ptr<BulkJob> bulk;
+        size_t index;
+        // Identical loads that joined this job, and the key they joined it by.
+        std::string key;
+        std::vector<napi_deferred> waiters;
+        std::shared_ptr<Request> request;
+        std::shared_ptr<ImageSource> imageSource;
+        std::shared_ptr<Target> target;
+        std::shared_ptr<CompletionQueue> completionQueue;
+        napi_deferred deferred;
+        napi_ref onFrame;
+        // Main thread. The promise was rejected before the final result, by a throwing frame callback.
+        bool settled;
+        // Tells the pool thread to stop decoding frames nobody will receive.
+        std::atomic<bool> cancelled;
+
+        Job() : cancelled(false) {
+            this->index = 0;
+            this->deferred = nullptr;
+            this->onFrame = nullptr;
+            this->settled = false;
+        }
+
+        // Main thread. Drops the references held on javascript values.
+        void Release(Env env) {
+            this->target->Release(env);
+
+            if (this->onFrame) {
+                napi_delete_reference(env, this->onFrame);
+                this->onFrame = nullptr;
+            }
+        }
+};
+
+// Many sources loaded with one request. Results stay native until the last one arrives and then settle a single promise
+// with all of them, so there is one promise and one crossing into javascript for the whole bulk load.
+class BulkJob {
+    private:
+        napi_deferred deferred;
+        size_t count;
+        bool ordered;
+        // Main thread. Index of the source and its result, in completion order.
+        std::vector<std::pair<size_t, std::shared_ptr<Result>>> results;
+        // Main thread. Shared outputs are read from their targets when the results become values, so the targets stay
+        // referenced until then.
+        std::vector<std::shared_ptr<Target>> targets;
+
+    public:
+        // With ordered false, the results are kept in the order the loads finished instead of the order of the sources.
+        BulkJob(napi_deferred deferred, const size_t count, const bool ordered) {
+            this->deferred = deferred;
+            this->count = count;
+            this->ordered = ordered;
+        }
+
+        // Results of a bulk load cut short by environment teardown are never delivered.
+        ~BulkJob() {
+            for (auto& entry : this->results) {
+                entry.second->Discard();
+            }
+        }
+
+        // Main thread.
+        void Add(Env env, const size_t index, const std::shared_ptr<Result> result, const std::shared_ptr<Target> target) {
+            this->results.push_back(std::make_pair(index, result));
+            this->targets.push_back(target);
+
+            if (this->results.size() == this->count) {
+                this->Resolve(env);
+            }
+        }
+
+    private:
+        void Resolve(Env env) {
+            auto array = Array::New(env, this->count);
+
+            for (size_t i = 0; i < this->results.size(); i++) {
+                auto index = this->results[i].first;
+                Value value;
+
+                // A failed source does not fail the others. Its slot holds the Error instead.
+                try {
+                    value = this->results[i].second->ToValue(env);
+                } catch (const Error& e) {
+                    value = e.Value();
+                }
+
+                auto object = value.As<Object>();
+                auto header = object.Get(BUFFER_HEADER);
+
+                (header.IsObject() ? header.As<Object>() : object).Set(HEADER_INDEX, Number::New(env, index));
+                array[this->ordered ? index : i] = value;
+            }
+
+            for (auto& target : this->targets) {
+                target->Release(env);
+            }
+
+            this->results.clear();
+            this->targets.clear();
+            napi_resolve_deferred(env, this->deferred, array);
+        }
+};
+
+class JobCompletion : public Completion {
+    private:
+        std::shared_ptr<Job> job;
+        std::shared_ptr<Result> result;
+
+    public:
+        JobCompletion(const std::shared_ptr<Job> job, const std::shared_ptr<Result> result) {
+            this->job = job;
+            this->result = result;
+        }
+
+        void Complete(napi_env env);
+
+    private:
+        void CompleteFrame(Env env);
+        void Discard();
+};
+
+class Canvas {
+    private:
+        float scaleX;
+        float scaleY;
+        int width;
+        int height;
+        stbir_filter filter;
+        bool nearest;
+        ResizeEngine engine;
+        bool fast;
+        bool premultiplied;
+        // The pixels handed to resizes are already premultiplied, by a load that owns them.
+        bool sourcePremultiplied;
+        bool resize;
+
+        // Region of the source image that is resized to the canvas, in source pixels. The whole image unless the
+        // constraint crops.
+        bool region;
+        float regionLeft;
+        float regionTop;
+        float regionRight;
+        float regionBottom;
+
+        // Rectangle of the canvas the image is drawn to. The whole canvas unless the constraint pads, in which case the
+        // rest of the canvas is filled with the background.
+        bool pad;
+        int contentX;
+        int contentY;
+        int contentWidth;
+        int contentHeight;
+
+    public:
+        Canvas(const std::shared_ptr<Request> request, const int sourceWidth, const int sourceHeight)
+            : Canvas(request, sourceWidth, sourceHeight, request->GetWidth(), request->GetHeight()) {
+        }
+
+        // Resize to the given bounding box instead of the request's.
+        Canvas(const std::shared_ptr<Request> request, const int sourceWidth, const int sourceHeight, const int destWidth,
+                const int destHeight) {
+            this->filter = request->GetFilter();
+            this->nearest = request->IsNearest();
+            this->engine = request->GetEngine();
+            this->fast = request->IsFast();
+            this->premultiplied = request->IsPremultiplied();
+            this->sourcePremultiplied = false;
+            this->region = false;
+            this->regionLeft = 0;
+            this->regionTop = 0;
+            this->regionRight = sourceWidth;
+            this->regionBottom = sourceHeight;
+            this->pad = false;
+
+            this->resize = (destWidth > 0 && destHeight > 0) && !(sourceWidth == destWidth && sourceHeight == destHeight);
+
+            if (this->resize) {
+                auto constraint = request->GetConstraint();
+
+                if (constraint == RESIZE_CONSTRAINT_CONTAIN && sourceWidth <= destWidth && sourceHeight <= destHeight) {
+                    // smaller than the bounding box. no resizing required.
+                    this->width = sourceWidth;
+                    this->height = sourceHeight;
+                    this->resize = false;
+                } else if (request->IsIgnoreAspectRatio()) {
+                    // stretch to the bounding box. contain only squishes the dimensions that do not fit.
+                    this->width = constraint == RESIZE_CONSTRAINT_CONTAIN ? std::min(sourceWidth, destWidth) : destWidth;
+                    this->height = constraint == RESIZE_CONSTRAINT_CONTAIN ? std::min(sourceHeight, destHeight) : destHeight;
+                } else if (constraint == RESIZE_CONSTRAINT_COVER) {
+                    // scale by aspect ratio until the canvas is covered, then crop the overflow by gravity
+                    auto scale = AspectScale(constraint, sourceWidth, sourceHeight, destWidth, destHeight);
+                    auto regionWidth = std::min((float)sourceWidth, (float)destWidth / scale);
+                    auto regionHeight = std::min((float)sourceHeight, (float)destHeight / scale);
+
+                    this->width = destWidth;
+                    this->height = destHeight;
+                    this->scaleX = scale;
+                    this->scaleY = scale;
+                    this->region = true;
+                    this->regionLeft = ((float)sourceWidth - regionWidth)*request->GetGravityX();
+                    this->regionTop = ((float)sourceHeight - regionHeight)*request->GetGravityY();
+                    this->regionRight = this->regionLeft + regionWidth;
+                    this->regionBottom = this->regionTop + regionHeight;
+                } else {
+                    // scale by aspect ratio until the image fits. pad then places it on the canvas by gravity.
+                    auto scale = AspectScale(constraint, sourceWidth, sourceHeight, destWidth, destHeight);
+                    auto contentWidth = std::min(destWidth, std::max(1, (int)roundf((float)sourceWidth*scale)));
+                    auto contentHeight = std::min(destHeight, std::max(1, (int)roundf((float)sourceHeight*scale)));
+
+                    if (constraint == RESIZE_CONSTRAINT_PAD) {
+                        this->width = destWidth;
+                        this->height = destHeight;
+                        this->pad = true;
+                        this->contentWidth = contentWidth;
+                        this->contentHeight = contentHeight;
+                        this->contentX = (int)((float)(destWidth - contentWidth)*request->GetGravityX());
+                        this->contentY = (int)((float)(destHeight - contentHeight)*request->GetGravityY());
+                    } else {
+                        this->width = contentWidth;
+                        this->height = contentHeight;
+                    }
+
+                    // the image may already fit one side exactly, and then only needs placing
+                    this->resize = contentWidth != sourceWidth || contentHeight != sourceHeight;
+                }
+            } else {
+                this->width = sourceWidth;
+                this->height = sourceHeight;
+            }
+
+            // Cover crops the scaled source. Everything else scales the source to the image drawn.
+            if (!this->region) {
+                this->scaleX = ScaleFactor(sourceWidth, this->pad ? this->contentWidth : this->width);
+                this->scaleY = ScaleFactor(sourceHeight, this->pad ? this->contentHeight : this->height);
+            }
+
+            if (!this->pad) {
+                this->contentX = 0;
+                this->contentY = 0;
+                this->contentWidth = this->width;
+                this->contentHeight = this->height;
+            }
+        }
+
+        float GetScaleX() const {
+            return this->scaleX;
+        }
+
+        float GetScaleY() const {
+            return this->scaleY;
+        }
+
+        int GetWidth() const {
+            return this->width;
+        }
+
+        int GetHeight() const {
+            return this->height;
+        }
+
+        stbir_filter GetStbFilter() const {
+            return this->filter;
+        }
+
+        bool IsNearest() const {
+            return this->nearest;
+        }
+
+        // Whether resizes leave the pixels premultiplied by alpha.
+        bool IsPremultiplied() const {
+            return this->premultiplied;
+        }
+
+        bool IsSourcePremultiplied() const {
+            return this->sourcePremultiplied;
+        }
+
+        // How resamplers treat the alpha of the source to leave the output as requested.
+        ResampleAlpha GetResampleAlpha() const {
+            if (this->sourcePremultiplied) {
+                return RESAMPLE_ALPHA_NONE;
+            }
+
+            return this->premultiplied ? RESAMPLE_ALPHA_PREMULTIPLY : RESAMPLE_ALPHA_WEIGHTED;
+        }
+
+        ResizeEngine GetEngine() const {
+            return this->engine;
+        }
+
+        bool IsFast() const {
+            return this->fast;
+        }
+
+        bool IsResize() const {
+            return this->resize;
+        }
+
+        bool IsRegion() const {
+            return this->region;
+        }
+
+        float GetRegionLeft() const {
+            return this->regionLeft;
+        }
+
+        float GetRegionTop() const {
+            return this->regionTop;
+        }
+
+        float GetRegionRight() const {
+            return this->regionRight;
+        }
+
+        float GetRegionBottom() const {
+            return this->regionBottom;
+        }
+
+        bool IsPad() const {
+            return this->pad;
+        }
+
+        int GetContentWidth() const {
+            return this->contentWidth;
+        }
+
+        int GetContentHeight() const {
+            return this->contentHeight;
+        }
+
+        // Byte offset of the first pixel of the content rectangle, in 4 channel pixels with the given row stride.
+        size_t GetContentOffset(const size_t stride) const {
+            return (size_t)this->contentY*stride + (size_t)this->contentX*4;
+        }
+
+        // Whether the output is the whole image, resized, so smaller outputs can be resized from it. Premultiplied
+        // outputs would be premultiplied again.
+        bool IsCascadable() const {
+            return !this->region && !this->pad && !this->premultiplied;
+        }
+
+        // This canvas for another, uncropped width x height source image, such as a larger output in a cascade.
+        std::shared_ptr<Canvas> ForSource(const int width, const int height) const {
+            auto canvas = std::shared_ptr<Canvas>(new Canvas(*this));
+
+            canvas->regionLeft = 0;
+            canvas->regionTop = 0;
+            canvas->regionRight = width;
+            canvas->regionBottom = height;
+
+            return canvas;
+        }
+
+        // This canvas for a width x height copy of the source image from (left, top), scaled down by scale. The region
+        // moves and scales with the image.
+        std::shared_ptr<Canvas> ForScaledSource(const int left, const int top, const float scale, const int width,
+                const int height) const {
+            auto canvas = std::shared_ptr<Canvas>(new Canvas(*this));
+
+            canvas->regionLeft = (this->regionLeft - left)*scale;
+            canvas->regionTop = (this->regionTop - top)*scale;
+            canvas->regionRight = (this->regionRight - left)*scale;
+            canvas->regionBottom = (this->regionBottom - top)*scale;
+            canvas->region = canvas->regionLeft != 0 || canvas->regionTop != 0 || canvas->regionRight != width
+                || canvas->regionBottom != height;
+
+            return canvas;
+        }
+
+        // This canvas for the same source, once premultiplied. Only for canvases that premultiply.
+        std::shared_ptr<Canvas> ForPremultipliedSource() const {
+            auto canvas = std::shared_ptr<Canvas>(new Canvas(*this));
+
+            canvas->sourcePremultiplied = true;
+
+            return canvas;
+        }
+};
+
+std::string PixelFormatToString(const PixelFormat pixelFormat) {
+    switch(pixelFormat) {
+        case PIXEL_FORMAT_RGBA:
+            return "rgba";
+        case PIXEL_FORMAT_ABGR:
+            return "abgr";
+        case PIXEL_FORMAT_ARGB:
+            return "argb";
+        case PIXEL_FORMAT_BGRA:
+            return "bgra";
+        case PIXEL_FORMAT_RGB:
+            return "rgb";
+        default:
+            return "";
+    }
+}
+
+PixelFormat PixelFormatFromString(const std::string& str) {
+    if (str == "rgba") {
+        return PIXEL_FORMAT_RGBA;
+    } else if (str == "argb") {
+        return PIXEL_FORMAT_ARGB;
+    } else if (str == "abgr") {
+        return PIXEL_FORMAT_ABGR;
+    } else if (str == "bgra") {
+        return PIXEL_FORMAT_BGRA;
+    }
+
+    return PIXEL_FORMAT_UNKNOWN;
+}
+
+stbir_filter FilterFromString(const std::string& str) {
+    if (str == FILTER_BOX) {
+        return STBIR_FILTER_BOX;
+    } else if (str == FILTER_TENT) {
+        return STBIR_FILTER_TRIANGLE;
+    } else if (str == FILTER_GAUSSIAN) {
+        return STBIR_FILTER_CUBICBSPLINE;
+    }
+
+    return STBIR_FILTER_DEFAULT;
+}
+
+ResizeConstraint ConstraintFromString(const std::string& str) {
+    if (str == CONSTRAINT_CONTAIN) {
+        return RESIZE_CONSTRAINT_CONTAIN;
+    } else if (str == CONSTRAINT_COVER) {
+        return RESIZE_CONSTRAINT_COVER;
+    } else if (str == CONSTRAINT_PAD) {
+        return RESIZE_CONSTRAINT_PAD;
+    }
+
+    return RESIZE_CONSTRAINT_FIT;
+}
+
+ResizeEngine EngineFromString(const std::string& str) {
+    return str == ENGINE_FIXED ? RESIZE_ENGINE_FIXED : RESIZE_ENGINE_FLOAT;
+}
+
+int GetChannels(const PixelFormat pixelFormat) {
+    switch(pixelFormat) {
+        case PIXEL_FORMAT_RGBA:
+        case PIXEL_FORMAT_ABGR:
+        case PIXEL_FORMAT_ARGB:
+        case PIXEL_FORMAT_BGRA:
+            return 4;
+        case PIXEL_FORMAT_RGB:
+            return 3;
+        default:
+            return -1;
+    }
+}
+
+int IsBigEndian() {
+    int i = 1;
+    return ! *((char *)&i);
+}
+
+PixelFormat GetPixelFormatFromComponent(int component) {
+    return (component == 3) ?  PIXEL_FORMAT_RGB : PIXEL_FORMAT_RGBA;
+}
+
+void ConvertPixelsLE(unsigned char *bytes, int len, int bytesPerPixel, PixelFormat format) {
+    auto i = 0;
+    unsigned char r, g, b, a;
+
+    while (i < len) {
+        r = bytes[i];
+        g = bytes[i + 1];
+        b = bytes[i + 2];
+        a = (bytesPerPixel == 4) ? bytes[i + 3] : 255;
+
+        switch(format) {
+            case PIXEL_FORMAT_RGBA:
+                bytes[i    ] = a;
+                bytes[i + 1] = b;
+                bytes[i + 2] = g;
+                bytes[i + 3] = r;
+                break;
+            case PIXEL_FORMAT_ABGR:
+                bytes[i    ] = r;
+                bytes[i + 1] = g;
+                bytes[i + 2] = b;
+                bytes[i + 3] = a;
+                break;
+            case PIXEL_FORMAT_ARGB:
+                bytes[i    ] = b;
+                bytes[i + 1] = g;
+                bytes[i + 2] = r;
+                bytes[i + 3] = a;
+                break;
+            case PIXEL_FORMAT_BGRA:
+                bytes[i    ] = a;
+                bytes[i + 1] = r;
+                bytes[i + 2] = g;
+                bytes[i + 3] = b;
+                break;
+            case PIXEL_FORMAT_RGB:
+                bytes[i    ] = b;
+                bytes[i + 1] = g;
+                bytes[i + 2] = r;
+                break;
+            default:
+                break;
+        }
+
+        i += bytesPerPixel;
+    }
+}
+
+void ConvertPixelsBE(unsigned char *bytes, int len, int bytesPerPixel, PixelFormat format) {
+    auto i = 0;
+    unsigned char r, g, b, a;
+
+    while (i < len) {
+        r = bytes[i];
+        g = bytes[i + 1];
+        b = bytes[i + 2];
+        a = (bytesPerPixel == 4) ? bytes[i + 3] : 255;
+
+        switch(format) {
+            case PIXEL_FORMAT_RGBA:
+                bytes[i    ] = r;
+                bytes[i + 1] = g;
+                bytes[i + 2] = b;
+                bytes[i + 3] = a;
+                break;
+            case PIXEL_FORMAT_ABGR:
+                bytes[i    ] = a;
+                bytes[i + 1] = b;
+                bytes[i + 2] = g;
+                bytes[i + 3] = r;
+                break;
+            case PIXEL_FORMAT_ARGB:
+                bytes[i    ] = a;
+                bytes[i + 1] = r;
+                bytes[i + 2] = g;
+                bytes[i + 3] = b;
+                break;
+            case PIXEL_FORMAT_BGRA:
+                bytes[i    ] = b;
+                bytes[i + 1] = g;
+                bytes[i + 2] = r;
+                bytes[i + 3] = a;
+                break;
+            case PIXEL_FORMAT_RGB:
+                bytes[i    ] = r;
+                bytes[i + 1] = g;
+                bytes[i + 2] = b;
+                break;
+            default:
+                break;
+        }
+
+        i += bytesPerPixel;
+    }
+}
+
+void ConvertRows(unsigned char *pixels, int width, int height, size_t stride, int bytesPerPixel, PixelFormat format) {
+    auto rowSize = (size_t)width*bytesPerPixel;
+    auto convert = IsBigEndian() ? ConvertPixelsBE : ConvertPixelsLE;
+
+    if (stride == rowSize) {
+        convert(pixels, rowSize*height, bytesPerPixel, format);
+    } else {
+        for (auto y = 0; y < height; y++) {
+            convert(pixels + y*stride, rowSize, bytesPerPixel, format);
+        }
+    }
+}
+
+void GetChannelOffsets(PixelFormat format, int offsets[4]) {
+    // Converting one pixel whose channels hold their own index shows where ConvertRows() moves each of them.
+    unsigned char pixel[4] = { 0, 1, 2, 3 };
+
+    ConvertRows(pixel, 1, 1, 4, 4, format);
+
+    for (int i = 0; i < 4; i++) {
+        offsets[pixel[i]] = i;
+    }
+}
+
+void CopyRows(const unsigned char *source, size_t sourceStride, unsigned char *dest, size_t destStride, size_t rowSize, int height) {
+    if (sourceStride == rowSize && destStride == rowSize) {
+        memcpy(dest, source, rowSize*height);
+    } else {
+        for (auto y = 0; y < height; y++) {
+            memcpy(dest + y*destStride, source + y*sourceStride, rowSize);
+        }
+    }
+}
+
+void FillRows(unsigned char *pixels, int width, int height, size_t stride, const unsigned char *color) {
+    for (auto y = 0; y < height; y++) {
+        auto row = pixels + y*stride;
+
+        for (auto x = 0; x < width; x++) {
+            memcpy(row + x*4, color, 4);
+        }
+    }
+}
+
+// Where a gravity places something along one axis: 0 towards start, 1 towards end and 0.5 for the middle.
+float GravityFactor(const std::string& gravity, const char *start, const char *end) {
+    if (gravity.find(start) != std::string::npos) {
+        return 0.f;
+    } else if (gravity.find(end) != std::string::npos) {
+        return 1.f;
+    }
+
+    return 0.5f;
+}
+
+// Targets are written at any byte offset, so floats are stored without assuming alignment. Compilers emit the copy as a
+// single unaligned store.
+static inline void StoreFloat(unsigned char *dest, const float value) {
+    memcpy(dest, &value, sizeof(float));
+}
+
+void WriteTensor(const std::shared_ptr<Request> request, const unsigned char *pixels, int width, int height, size_t stride,
+        unsigned char *output) {
+    auto planar = request->IsPlanar();
+    auto planeSize = (size_t)width*height;
+
+    if (request->IsFloatTensor()) {
+        float scale[3];
+        float bias[3];
+
+        // (value/255 - mean)/std as one multiply-add per element.
+        for (auto c = 0; c < 3; c++) {
+            scale[c] = 1.f / (255.f*request->GetStd()[c]);
+            bias[c] = -request->GetMean()[c] / request->GetStd()[c];
+        }
+
+        if (planar) {
+            // One channel plane at a time, so the inner loop is a strided load and a contiguous store that compilers
+            // vectorize.
+            for (auto c = 0; c < 3; c++) {
+                for (auto y = 0; y < height; y++) {
+                    auto row = pixels + y*stride + c;
+                    auto out = output + (c*planeSize + (size_t)y*width)*sizeof(float);
+
+                    for (auto x = 0; x < width; x++) {
+                        StoreFloat(out + x*sizeof(float), (float)row[x*4]*scale[c] + bias[c]);
+                    }
+                }
+            }
+        } else {
+            for (auto y = 0; y < height; y++) {
+                auto row = pixels + y*stride;
+                auto out = output + (size_t)y*width*3*sizeof(float);
+
+                for (auto x = 0; x < width; x++) {
+                    StoreFloat(out + (x*3    )*sizeof(float), (float)row[x*4    ]*scale[0] + bias[0]);
+                    StoreFloat(out + (x*3 + 1)*sizeof(float), (float)row[x*4 + 1]*scale[1] + bias[1]);
+                    StoreFloat(out + (x*3 + 2)*sizeof(float), (float)row[x*4 + 2]*scale[2] + bias[2]);
+                }
+            }
+        }
+    } else if (planar) {
+        for (auto c = 0; c < 3; c++) {
+            for (auto y = 0; y < height; y++) {
+                auto row = pixels + y*stride + c;
+                auto out = output + c*planeSize + (size_t)y*width;
+
+                for (auto x = 0; x < width; x++) {
+                    out[x] = row[x*4];
+                }
+            }
+        }
+    } else {
+        for (auto y = 0; y < height; y++) {
+            auto row = pixels + y*stride;
+            auto out = output + (size_t)y*width*3;
+
+            for (auto x = 0; x < width; x++) {
+                out[x*3    ] = row[x*4    ];
+                out[x*3 + 1] = row[x*4 + 1];
+                out[x*3 + 2] = row[x*4 + 2];
+            }
+        }
+    }
+}
+
+void AddBufferAllocation(Env env, void *bufferData) {
+    Addon::Get(env)->bufferAllocations[bufferData]++;
+}
+
+void ReleaseBufferAllocation(Env env, void *bufferData) {
+    auto addon = Addon::Get(env);
+
+    // Without instance data, the environment is gone and freed everything it tracked.
+    if (addon == nullptr) {
+        return;
+    }
+
+    auto it = addon->bufferAllocations.find(bufferData);
+
+    if (it != addon->bufferAllocations.end() && --it->second == 0) {
+        free(bufferData);
+        addon->bufferAllocations.erase(it);
+    }
+}
+
+void *DecodeAlloc(size_t size) {
+    return DecodeMemory::ForThread()->Alloc(size);
+}
+
+void *DecodeRealloc(void *ptr, size_t size) {
+    return DecodeMemory::ForThread()->Realloc(ptr, size);
+}
+
+void DecodeFree(void *ptr) {
+    if (ptr != nullptr) {
+        DecodeMemory::ForThread()->Free(ptr);
+    }
+}
+
+void *ScratchAlloc(size_t size, void *context) {
+    return context ? static_cast<ScratchMemory *>(context)->Alloc(size) : malloc(size);
+}
+
+void ScratchFree(void *ptr, void *context) {
+    if (context) {
+        static_cast<ScratchMemory *>(context)->Free(ptr);
+    } else {
+        free(ptr);
+    }
+}
+
+void CalculateFilters(void *contributors, float *coefficients, int filter, float scale, float shift, int inputSize,
+        int outputSize) {
+    auto tables = FilterTables::Find(filter, scale, shift, inputSize, outputSize);
+
+    if (tables) {
+        tables->CopyTo(contributors, coefficients);
+        return;
+    }
+
+    auto resizeFilter = static_cast<stbir_filter>(filter);
+    auto contributorCount = stbir__get_contributors(scale, resizeFilter, inputSize, outputSize);
+    auto coefficientCount = contributorCount*stbir__get_coefficient_width(resizeFilter, scale);
+
+    stbir__calculate_filters(static_cast<stbir__contributors *>(contributors), coefficients, resizeFilter, scale, shift,
+        inputSize, outputSize);
+
+    FilterTables::Add(filter, scale, shift, inputSize, outputSize, std::shared_ptr<const FilterTables>(
+        new FilterTables(contributors, contributorCount*sizeof(stbir__contributors), coefficients, coefficientCount)));
+}
+
+float ScaleFactor(const int source, const int dest) {
+    return 1.f + (((float)dest - (float)source) / (float)source);
+}
+
+// Uniform scale that takes the source to the bounding box keeping its aspect ratio: the larger of the two axis scales
+// for cover, so the box is covered, and the smaller for the other constraints, so the source fits.
+float AspectScale(const ResizeConstraint constraint, const int sourceWidth, const int sourceHeight, const int destWidth,
+        const int destHeight) {
+    auto scaleX = (float)destWidth / (float)sourceWidth;
+    auto scaleY = (float)destHeight / (float)sourceHeight;
+
+    return constraint == RESIZE_CONSTRAINT_COVER ? std::max(scaleX, scaleY) : std::min(scaleX, scaleY);
+}
+
+// stbir's filter tables for one axis, gathered into the taps of each output pixel for the fixed point resampler. Taps
+// outside of the image are folded into the edge pixels, which is what STBIR_EDGE_CLAMP reads for them.
+ResampleAxis GatherFilters(stbir_filter filter, const float scale, const float shift, const int inputSize,
+        const int outputSize) {
+    struct Tap {
+        int output;
+        int input;
+        float weight;
+    };
+
+    auto upsample = stbir__use_upsampling(scale);
+
+    if (filter == STBIR_FILTER_DEFAULT) {
+        filter = upsample ? STBIR_DEFAULT_FILTER_UPSAMPLE : STBIR_DEFAULT_FILTER_DOWNSAMPLE;
+    }
+
+    auto contributorCount = stbir__get_contributors(scale, filter, inputSize, outputSize);
+    auto coefficientWidth = stbir__get_coefficient_width(filter, scale);
+    auto margin = upsample ? 0 : stbir__get_filter_pixel_margin(filter, scale);
+    std::vector<stbir__contributors> contributors(contributorCount);
+    std::vector<float> coefficients((size_t)contributorCount*coefficientWidth);
+    std::vector<Tap> taps;
+
+    CalculateFilters(contributors.data(), coefficients.data(), filter, scale, shift, inputSize, outputSize);
+
+    // Upsampling tables list the input pixels of each output pixel. Downsampling tables list the output pixels of each
+    // input pixel, starting margin pixels before the image.
+    for (int i = 0; i < contributorCount; i++) {
+        auto& contributor = contributors[i];
+
+        for (int n = contributor.n0; n <= contributor.n1; n++) {
+            auto weight = coefficients[(size_t)i*coefficientWidth + n - contributor.n0];
+            auto input = std::min(std::max(upsample ? n : i - margin, 0), inputSize - 1);
+
+            taps.push_back({ upsample ? i : n, input, weight });
+        }
+    }
+
+    std::vector<int> first(outputSize, inputSize - 1);
+    std::vector<int> last(outputSize, 0);
+    auto tapCount = 1;
+
+    for (auto& tap : taps) {
+        first[tap.output] = std::min(first[tap.output], tap.input);
+        last[tap.output] = std::max(last[tap.output], tap.input);
+        tapCount = std::max(tapCount, last[tap.output] - first[tap.output] + 1);
+    }
+
+    // Every output pixel reads the same number of taps, so those near the end start early enough to stay in the image.
+    std::vector<float> weights((size_t)outputSize*tapCount);
+
+    for (auto& start : first) {
+        start = std::min(start, inputSize - tapCount);
+    }
+
+    for (auto& tap : taps) {
+        weights[(size_t)tap.output*tapCount + tap.input - first[tap.output]] += tap.weight;
+    }
+
+    return ResampleAxis(inputSize, outputSize, tapCount, first.data(), weights.data());
+}
+
+bool ResizePixels(const unsigned char *pixels, const int width, const int height, const size_t stride,
+        const std::shared_ptr<Canvas> canvas, unsigned char *output, const size_t outputStride, const int channels) {
+    auto alphaChannelIndex = channels == 4 ? 3 : STBIR_ALPHA_CHANNEL_NONE;
+
+    // A canvas that does not crop resizes whichever image it is given whole. The region describes the source it was
+    // made for.
+    if (!canvas->IsRegion() && (canvas->GetRegionRight() != width || canvas->GetRegionBottom() != height)) {
+        return ResizePixels(pixels, width, height, stride, canvas->ForSource(width, height), output, outputStride,
+            channels);
+    }
+
+    if (canvas->IsNearest() && channels == 4) {
+        output += canvas->GetContentOffset(outputStride);
+
+        NearestRGBA8(pixels, width, height, stride, output, canvas->GetContentWidth(), canvas->GetContentHeight(),
+            outputStride, canvas->GetRegionLeft(), canvas->GetRegionTop(), canvas->GetRegionRight(),
+            canvas->GetRegionBottom());
+
+        // Copies only, so the few output pixels are premultiplied instead of the input.
+        if (canvas->IsPremultiplied() && !canvas->IsSourcePremultiplied()) {
+            PremultiplyRGBA8(output, canvas->GetContentWidth(), canvas->GetContentHeight(), outputStride, output,
+                outputStride);
+        }
+
+        return true;
+    }
+
+    if (canvas->IsFast() && channels == 4
+            && canvas->GetRegionRight() - canvas->GetRegionLeft() >= 2*canvas->GetContentWidth()
+            && canvas->GetRegionBottom() - canvas->GetRegionTop() >= 2*canvas->GetContentHeight()) {
+        return ResizePixelsFast(pixels, width, height, stride, canvas, output, outputStride);
+    }
+
+    if (canvas->GetEngine() == RESIZE_ENGINE_FIXED && channels == 4) {
+        return ResizePixelsFixed(pixels, width, height, stride, canvas, output, outputStride);
+    }
+
+    // Hand stbir the whole pixels around the region, so it decodes none of the rows and columns outside of it, and the
+    // fractional rest of the region as texture coordinates.
+    auto left = std::max(0, (int)floorf(canvas->GetRegionLeft()));
+    auto top = std::max(0, (int)floorf(canvas->GetRegionTop()));
+    auto right = std::min(width, (int)ceilf(canvas->GetRegionRight()));
+    auto bottom = std::min(height, (int)ceilf(canvas->GetRegionBottom()));
+    auto regionWidth = (float)(right - left);
+    auto regionHeight = (float)(bottom - top);
+    auto input = pixels + (size_t)top*stride + (size_t)left*channels;
+    auto inputStride = stride;
+    unsigned char *premultiplied = nullptr;
+    auto flags = 0;
+
+    // stbir would premultiply every row it reads and divide alpha back out of every row it writes. Premultiplied
+    // pixels are filtered as they are and the output stays premultiplied. Loads that own their pixels premultiply them
+    // in place. Pixels shared with other loads are premultiplied into a copy of the region.
+    if (canvas->IsSourcePremultiplied()) {
+        flags = STBIR_FLAG_ALPHA_PREMULTIPLIED;
+    } else if (canvas->IsPremultiplied() && channels == 4) {
+        inputStride = (size_t)(right - left)*channels;
+        premultiplied = (unsigned char *)malloc(inputStride*(bottom - top));
+
+        if (premultiplied == nullptr) {
+            return false;
+        }
+
+        PremultiplyRGBA8(input, right - left, bottom - top, stride, premultiplied, inputStride);
+        input = premultiplied;
+        flags = STBIR_FLAG_ALPHA_PREMULTIPLIED;
+    }
+
+    auto result = stbir_resize_region(
+        // input
+        input,
+        right - left,
+        bottom - top,
+        inputStride,
+        // output
+        output + canvas->GetContentOffset(outputStride),
+        canvas->GetContentWidth(),
+        canvas->GetContentHeight(),
+        outputStride,
+        // channels
+        STBIR_TYPE_UINT8,
+        channels,
+        alphaChannelIndex,
+        // settings
+        flags,
+        STBIR_EDGE_CLAMP,
+        STBIR_EDGE_CLAMP,
+        canvas->GetStbFilter(),
+        canvas->GetStbFilter(),
+        STBIR_COLORSPACE_LINEAR,
+        // context
+        ScratchMemory::ForThread(),
+        // region
+        (canvas->GetRegionLeft() - left) / regionWidth,
+        (canvas->GetRegionTop() - top) / regionHeight,
+        (canvas->GetRegionRight() - left) / regionWidth,
+        (canvas->GetRegionBottom() - top) / regionHeight
+    ) != 0;
+
+    free(premultiplied);
+
+    return result;
+}
+
+// Resizes with the fixed point resampler, through the same filter tables stbir would use for the resize.
+bool ResizePixelsFixed(const unsigned char *pixels, const int width, const int height, const size_t stride,
+        const std::shared_ptr<Canvas> canvas, unsigned char *output, const size_t outputStride) {
+    auto left = 0;
+    auto top = 0;
+    auto right = width;
+    auto bottom = height;
+    auto s0 = 0.f;
+    auto t0 = 0.f;
+    auto s1 = 1.f;
+    auto t1 = 1.f;
+
+    if (canvas->IsRegion()) {
+        left = std::max(0, (int)floorf(canvas->GetRegionLeft()));
+        top = std::max(0, (int)floorf(canvas->GetRegionTop()));
+        right = std::min(width, (int)ceilf(canvas->GetRegionRight()));
+        bottom = std::min(height, (int)ceilf(canvas->GetRegionBottom()));
+        s0 = (canvas->GetRegionLeft() - left) / (float)(right - left);
+        t0 = (canvas->GetRegionTop() - top) / (float)(bottom - top);
+        s1 = (canvas->GetRegionRight() - left) / (float)(right - left);
+        t1 = (canvas->GetRegionBottom() - top) / (float)(bottom - top);
+    }
+
+    // Scale and shift as stbir__calculate_transform() works them out.
+    auto inputWidth = right - left;
+    auto inputHeight = bottom - top;
+    auto outputWidth = canvas->GetContentWidth();
+    auto outputHeight = canvas->GetContentHeight();
+    auto horizontal = GatherFilters(canvas->GetStbFilter(), ((float)outputWidth / inputWidth) / (s1 - s0),
+        s0 * outputWidth / (s1 - s0), inputWidth, outputWidth);
+    auto vertical = GatherFilters(canvas->GetStbFilter(), ((float)outputHeight / inputHeight) / (t1 - t0),
+        t0 * outputHeight / (t1 - t0), inputHeight, outputHeight);
+    auto scratch = ScratchMemory::ForThread();
+    auto memory = scratch->Alloc(ResampleScratchSize(horizontal, vertical));
+
+    if (memory == nullptr) {
+        return false;
+    }
+
+    ResampleRGBA8(pixels + (size_t)top*stride + (size_t)left*4, stride, output + canvas->GetContentOffset(outputStride),
+        outputStride, horizontal, vertical, canvas->GetResampleAlpha(), memory);
+    scratch->Free(memory);
+
+    return true;
+}
+
+// Halves the image with a 2x2 box filter until it is within 2x of the canvas, then resizes the rest of the way with
+// the requested filter. A power of two reduction of the whole image is done by halving alone.
+bool ResizePixelsFast(const unsigned char *pixels, const int width, const int height, const size_t stride,
+        const std::shared_ptr<Canvas> canvas, unsigned char *output, const size_t outputStride) {
+    // Only the pixels around the region are halved.
+    auto left = std::max(0, (int)floorf(canvas->GetRegionLeft()));
+    auto top = std::max(0, (int)floorf(canvas->GetRegionTop()));
+    auto sourceWidth = std::min(width, (int)ceilf(canvas->GetRegionRight())) - left;
+    auto sourceHeight = std::min(height, (int)ceilf(canvas->GetRegionBottom())) - top;
+    auto regionWidth = canvas->GetRegionRight() - canvas->GetRegionLeft();
+    auto regionHeight = canvas->GetRegionBottom() - canvas->GetRegionTop();
+    auto contentWidth = canvas->GetContentWidth();
+    auto contentHeight = canvas->GetContentHeight();
+    const unsigned char *source = pixels + (size_t)top*stride + (size_t)left*4;
+    auto sourceStride = stride;
+    auto scale = 1.f;
+    // Whether every halving so far was of even sizes, so the halved image is exactly the whole image scaled.
+    auto exact = !canvas->IsRegion();
+
+    // Levels alternate between two buffers. Every level after the first fits in the space of the first.
+    auto firstSize = (size_t)((sourceWidth + 1)/2)*4*((sourceHeight + 1)/2);
+    auto buffers = (unsigned char *)malloc(firstSize + (size_t)((sourceWidth + 3)/4)*4*((sourceHeight + 3)/4));
+
+    if (buffers == nullptr) {
+        return false;
+    }
+
+    // The canvas for the pixels being halved. A premultiplied output is premultiplied by the first halving, so the
+    // levels after it are too.
+    auto levelCanvas = canvas;
+
+    for (auto level = 0; regionWidth*scale >= 2*contentWidth && regionHeight*scale >= 2*contentHeight; level++) {
+        auto halfWidth = (sourceWidth + 1)/2;
+        auto halfHeight = (sourceHeight + 1)/2;
+
+        if (exact && sourceWidth == 2*contentWidth && sourceHeight == 2*contentHeight) {
+            HalveRGBA8(source, sourceWidth, sourceHeight, sourceStride, output + canvas->GetContentOffset(outputStride),
+                outputStride, levelCanvas->GetResampleAlpha());
+
+            free(buffers);
+            return true;
+        }
+
+        auto dest = (level % 2 == 0) ? buffers : buffers + firstSize;
+
+        HalveRGBA8(source, sourceWidth, sourceHeight, sourceStride, dest, (size_t)halfWidth*4,
+            levelCanvas->GetResampleAlpha());
+
+        if (canvas->IsPremultiplied() && !levelCanvas->IsSourcePremultiplied()) {
+            levelCanvas = canvas->ForPremultipliedSource();
+        }
+
+        exact = exact && sourceWidth % 2 == 0 && sourceHeight % 2 == 0;
+        source = dest;
+        sourceStride = (size_t)halfWidth*4;
+        sourceWidth = halfWidth;
+        sourceHeight = halfHeight;
+        scale /= 2;
+    }
+
+    auto result = ResizePixels(source, sourceWidth, sourceHeight, sourceStride,
+        levelCanvas->ForScaledSource(left, top, scale, sourceWidth, sourceHeight), output, outputStride, 4);
+
+    free(buffers);
+
+    return result;
+}
+
+std::shared_ptr<Result> Pipeline(const std::shared_ptr<Request> request, const std::shared_ptr<ImageSource> imageSource,
+        const std::shared_ptr<Target> outputTarget) {
+    DecodeMemory::Scope decodeMemory;
+
+    // Header.
+    if (!imageSource->IsLoaded()) {
+        if (!imageSource->Open() || !imageSource->IsLoaded()) {
+            return std::shared_ptr<Result>(new ErrorResult(imageSource->GetError()));
+        }
+
+        return std::shared_ptr<Result>(new HeaderResult(imageSource->GetWidth(), imageSource->GetHeight(), 4, request->IsHeaderQuery()));
+    }
+
+    // Batch.
+    if (request->IsBatch()) {
+        return PipelineBatch(request, imageSource);
+    }
+
+    // Crop.
+    if (request->IsCrop() && (request->GetCropX() + request->GetCropWidth(0) > imageSource->GetWidth()
+            || request->GetCropY() + request->GetCropHeight(0) > imageSource->GetHeight())) {
+        return std::shared_ptr<Result>(new ErrorResult("Crop region is outside of the image."));
+    }
+
+    // Multiple Sizes.
+    if (request->IsMultiSize()) {
+        return PipelineSizes(request, imageSource);
+    }
+
+    auto width = imageSource->GetWidth();
+    auto height = imageSource->GetHeight();
+    auto pixelFormat = PIXEL_FORMAT_RGBA;
+    auto requestedComponents = 4;
+    unsigned char *pixels = nullptr;
+    std::shared_ptr<SharedDecode> decode;
+    auto canvas = std::shared_ptr<Canvas>(new Canvas(request, request->GetCropWidth(width), request->GetCropHeight(height)));
+    // A tensor is converted from RGBA pixels, which are drawn to memory of their own first.
+    auto target = request->IsTensor() ? std::shared_ptr<Target>(new Target()) : outputTarget;
+    auto outputRowSize = (size_t)canvas->GetWidth()*requestedComponents;
+    auto outputSize = outputRowSize*canvas->GetHeight();
+    auto outputStride = target->GetStride(outputRowSize);
+    auto resultPixelSize = request->IsTensor() ? request->GetTensorPixelSize() : requestedComponents;
+    auto resultRowSize = (size_t)canvas->GetWidth()*resultPixelSize;
+    // Decoded pixels that are only copied to the output are decoded in the requested format. Everything else works on
+    // RGBA.
+    auto decodeFormat = (imageSource->IsSvg() || canvas->IsResize() || canvas->IsPad() || request->IsTensor()
+        || request->IsPremultiplied()) ? PIXEL_FORMAT_UNKNOWN : request->GetFormat();
+
+    // Animation.
+    if (request->IsAnimation()) {
+        return PipelineFrame(request, imageSource, canvas);
+    }
+
+    // Output Target.
+    if (request->IsShared() && !outputTarget->IsSet()) {
+        // A SharedArrayBuffer can only be created on the main thread. Ask for one of the final size and continue once
+        // it is attached to the target.
+        return std::shared_ptr<Result>(new AllocationResult(canvas->GetWidth(), canvas->GetHeight(), requestedComponents,
+            resultRowSize*canvas->GetHeight()));
+    }
+
+    if (outputTarget->IsSet()) {
+        outputTarget->Seek(outputTarget->GetStride(resultRowSize)*canvas->GetHeight());
+
+        auto error = outputTarget->Validate(canvas->GetWidth(), canvas->GetHeight(), resultPixelSize);
+
+        if (!error.empty()) {
+            return std::shared_ptr<Result>(new ErrorResult(error));
+        }
+    }
+
+    // Load Image Data.
+    if (imageSource->IsSvg()) {
+        if (width <= 0 || height <= 0) {
+            return std::shared_ptr<Result>(new ErrorResult("Cannot load an SVG without a width and height."));
+        }
+
+        auto rast = nsvgCreateRasterizer();
+
+        if (rast == nullptr) {
+            return std::shared_ptr<Result>(new ErrorResult(std::string("Failed to create rasterizer SVG.")));
+        }
+
+        float scaleX;
+        float scaleY;
+        size_t stride;
+
+        // Only the crop region is rasterized, by moving it to the origin.
+        if (request->IsDisableDecoderScaling()) {
+            scaleX = 1;
+            scaleY = 1;
+            width = request->GetCropWidth(width);
+            height = request->GetCropHeight(height);
+            stride = (size_t)width*requestedComponents;
+            pixels = (unsigned char *)malloc(stride*height);
+        } else {
+            scaleX = canvas->GetScaleX();
+            scaleY = canvas->GetScaleY();
+            width = canvas->GetContentWidth();
+            height = canvas->GetContentHeight();
+            // Rasterized at the final size, so it can be drawn straight into the target.
+            pixels = target->IsSet() ? target->GetPixels() : (unsigned char *)malloc(outputSize);
+            stride = outputStride;
+        }
+
+        if (pixels == nullptr) {
+            nsvgDeleteRasterizer(rast);
+            return std::shared_ptr<Result>(new ErrorResult(std::string("Failed to allocate memory for SVG.")));
+        }
+
+        if (request->IsDisableDecoderScaling()) {
+            nsvgRasterizeFull(rast, imageSource->GetSvg(), -request->GetCropX(), -request->GetCropY(), 1, 1, pixels, width,
+                height, stride);
+        } else {
+            if (canvas->IsPad()) {
+                FillRows(pixels, canvas->GetWidth(), canvas->GetHeight(), stride, request->GetBackground());
+            }
+
+            // A constraint that crops moves its region to the origin as well.
+            nsvgRasterizeFull(rast, imageSource->GetSvg(), -(request->GetCropX() + canvas->GetRegionLeft())*scaleX,
+                -(request->GetCropY() + canvas->GetRegionTop())*scaleY, scaleX, scaleY, pixels + canvas->GetContentOffset(stride),
+                width, height, stride);
+        }
+        nsvgDeleteRasterizer(rast);
+    } else {
+        // Rows below the crop region are not decoded at all, and those above it only as far as the format needs.
+        decode = request->IsCrop()
+            ? SharedDecode::Decode(imageSource, decodeFormat, request->GetCropY(),
+                request->GetCropY() + request->GetCropHeight(height))
+            : SharedDecode::Decode(imageSource, decodeFormat, 0, 0);
+
+        if (decode->GetPixels() == nullptr) {
+            return std::shared_ptr<Result>(new ErrorResult(decode->GetError()));
+        }
+
+        width = decode->GetWidth();
+        height = decode->GetHeight();
+
+        // Pixels no other load is reading are owned here, as if decoded directly. Shared pixels are only read.
+        if (decode.use_count() == 1) {
+            pixels = decode->Take();
+        }
+    }
+
+    const unsigned char *input = (pixels == nullptr && decode) ? decode->GetPixels() : pixels;
+    auto inputStride = (size_t)width*requestedComponents;
+
+    // The decode ends with the crop region, which is read in place. Only its pixels are resized or copied.
+    if (!imageSource->IsSvg()) {
+        input += request->GetCropOffset(width);
+        width = request->GetCropWidth(width);
+        height = request->GetCropHeight(height);
+    }
+
+    // SVGs scaled by the rasterizer are already drawn at the final size.
+    auto rasterized = imageSource->IsSvg() && !request->IsDisableDecoderScaling();
+
+    // Resize.
+    if (canvas->IsResize() && !rasterized) {
+        auto output = target->IsSet() ? target->GetPixels() : (unsigned char *)malloc(outputSize);
+
+        // Pixels owned here are premultiplied in place, so the resize reads them as they are instead of premultiplying
+        // a copy.
+        if (request->IsPremultiplied() && pixels != nullptr) {
+            auto region = pixels + (input - pixels);
+
+            PremultiplyRGBA8(region, width, height, inputStride, region, inputStride);
+            canvas = canvas->ForPremultipliedSource();
+        }
+
+        if (output != nullptr && canvas->IsPad()) {
+            FillRows(output, canvas->GetWidth(), canvas->GetHeight(), outputStride, request->GetBackground());
+        }
+
+        auto result = output != nullptr
+            && ResizePixels(input, width, height, inputStride, canvas, output, outputStride, requestedComponents);
+
+        free(pixels);
+
+        if (!result) {
+            if (!target->IsSet()) {
+                free(output);
+            }
+            return std::shared_ptr<Result>(new ErrorResult(std::string("Failed to resize the image.")));
+        }
+
+        pixels = output;
+    } else if (!rasterized && (target->IsSet() || input != pixels || canvas->IsPad())) {
+        auto output = target->IsSet() ? target->GetPixels() : (unsigned char *)malloc(outputSize);
+
+        if (output == nullptr) {
+            free(pixels);
+            return std::shared_ptr<Result>(new ErrorResult(std::string("Failed to allocate memory for the image.")));
+        }
+
+        if (canvas->IsPad()) {
+            FillRows(output, canvas->GetWidth(), canvas->GetHeight(), outputStride, request->GetBackground());
+        }
+
+        CopyRows(input, inputStride, output + canvas->GetContentOffset(outputStride), outputStride,
+            (size_t)canvas->GetContentWidth()*requestedComponents, canvas->GetContentHeight());
+        free(pixels);
+        pixels = output;
+    }
+
+    // Resizes premultiply as they go. Anything else is premultiplied here, leaving the background as it is.
+    if (request->IsPremultiplied() && (!canvas->IsResize() || rasterized)) {
+        auto content = pixels + canvas->GetContentOffset(outputStride);
+
+        PremultiplyRGBA8(content, canvas->GetContentWidth(), canvas->GetContentHeight(), outputStride, content,
+            outputStride);
+    }
+
+    width = canvas->GetWidth();
+    height = canvas->GetHeight();
+
+    // Tensor.
+    if (request->IsTensor()) {
+        auto tensorSize = resultRowSize*height;
+        auto tensor = outputTarget->IsSet() ? outputTarget->GetPixels() : (unsigned char *)malloc(tensorSize);
+
+        if (tensor == nullptr) {
+            free(pixels);
+            return std::shared_ptr<Result>(new ErrorResult(std::string("Failed to allocate memory for the tensor.")));
+        }
+
+        WriteTensor(request, pixels, width, height, outputStride, tensor);
+        free(pixels);
+
+        return std::shared_ptr<Result>(new TensorResult(width, height, request->GetLayout(), request->GetDtype(), tensor,
+            tensorSize, outputTarget));
+    }
+
+    // Colorspace.
+    if (request->GetFormat() != PIXEL_FORMAT_UNKNOWN) {
+        if (decodeFormat != request->GetFormat()) {
+            ConvertRows(pixels, width, height, outputStride, requestedComponents, request->GetFormat());
+        }
+
+        pixelFormat = request->GetFormat();
+    }
+
+    if (target->IsSet()) {
+        return std::shared_ptr<Result>(new TargetResult(width, height, GetChannels(pixelFormat), pixelFormat, target));
+    }
+
+    return std::shared_ptr<Result>(new BufferResult(width, height, GetChannels(pixelFormat), pixelFormat, pixels));
+}
+
+std::shared_ptr<Result> PipelineFrame(const std::shared_ptr<Request> request, const std::shared_ptr<ImageSource> imageSource,
+        const std::shared_ptr<Canvas> canvas) {
+    auto pixelFormat = (request->GetFormat() != PIXEL_FORMAT_UNKNOWN) ? request->GetFormat() : PIXEL_FORMAT_RGBA;
+    auto requestedComponents = 4;
+    auto width = canvas->GetWidth();
+    auto height = canvas->GetHeight();
+    auto outputRowSize = (size_t)width*requestedComponents;
+    int delay;
+
+    if (imageSource->IsSvg()) {
+        return std::shared_ptr<Result>(new ErrorResult("Cannot decode frames of an SVG."));
+    }
+
+    auto frame = imageSource->NextFrame(&delay);
+    auto frameStride = (size_t)imageSource->GetWidth()*requestedComponents;
+
+    if (frame == nullptr) {
+        if (!imageSource->GetError().empty()) {
+            return std::shared_ptr<Result>(new ErrorResult(imageSource->GetError()));
+        }
+
+        return std::shared_ptr<Result>(new AnimationResult(width, height, GetChannels(pixelFormat), pixelFormat,
+            imageSource->GetFrameCount()));
+    }
+
+    // The source composites the next frame over this one, so each frame is delivered in memory of its own. Resizing
+    // writes that memory anyway.
+    auto pixels = (unsigned char *)malloc(outputRowSize*height);
+
+    if (pixels == nullptr) {
+        return std::shared_ptr<Result>(new ErrorResult("Failed to allocate memory for frame."));
+    }
+
+    frame += request->GetCropOffset(imageSource->GetWidth());
+
+    if (canvas->IsPad()) {
+        FillRows(pixels, width, height, outputRowSize, request->GetBackground());
+    }
+
+    if (canvas->IsResize()) {
+        if (!ResizePixels(frame, request->GetCropWidth(imageSource->GetWidth()), request->GetCropHeight(imageSource->GetHeight()),
+                frameStride, canvas, pixels, outputRowSize, requestedComponents)) {
+            free(pixels);
+            return std::shared_ptr<Result>(new ErrorResult(std::string("Failed to resize the image.")));
+        }
+    } else {
+        CopyRows(frame, frameStride, pixels + canvas->GetContentOffset(outputRowSize), outputRowSize,
+            (size_t)canvas->GetContentWidth()*requestedComponents, canvas->GetContentHeight());
+
+        if (request->IsPremultiplied()) {
+            auto content = pixels + canvas->GetContentOffset(outputRowSize);
+
+            PremultiplyRGBA8(content, canvas->GetContentWidth(), canvas->GetContentHeight(), outputRowSize, content,
+                outputRowSize);
+        }
+    }
+
+    if (request->GetFormat() != PIXEL_FORMAT_UNKNOWN) {
+        ConvertRows(pixels, width, height, outputRowSize, requestedComponents, pixelFormat);
+    }
+
+    return std::shared_ptr<Result>(new FrameResult(width, height, GetChannels(pixelFormat), pixelFormat, pixels,
+        imageSource->GetFrameCount() - 1, delay));
+}
+
+std::shared_ptr<Result> PipelineSizes(const std::shared_ptr<Request> request, const std::shared_ptr<ImageSource> imageSource) {
+    auto& outputs = request->GetOutputs();
+    auto width = imageSource->GetWidth();
+    auto height = imageSource->GetHeight();
+    auto cropWidth = request->GetCropWidth(width);
+    auto cropHeight = request->GetCropHeight(height);
+    auto requestedComponents = 4;
+    std::vector<std::shared_ptr<Canvas>> canvases;
+    std::vector<unsigned char *> pixels(outputs.size(), nullptr);
+    std::vector<size_t> order;
+    std::vector<std::shared_ptr<BufferResult>> buffers;
+    unsigned char *source = nullptr;
+    std::string error;
+
+    for (size_t i = 0; i < outputs.size(); i++) {
+        canvases.push_back(std::shared_ptr<Canvas>(new Canvas(request, cropWidth, cropHeight, outputs[i].GetWidth(), outputs[i].GetHeight())));
+        order.push_back(i);
+    }
+
+    // Largest first, so a cascade always has the nearest larger output to resize from.
+    std::stable_sort(order.begin(), order.end(), [&canvases](const size_t a, const size_t b) {
+        return (size_t)canvases[a]->GetWidth()*canvases[a]->GetHeight() > (size_t)canvases[b]->GetWidth()*canvases[b]->GetHeight();
+    });
+
+    // Load Image Data.
+    if (imageSource->IsSvg()) {
+        if (width <= 0 || height <= 0) {
+            return std::shared_ptr<Result>(new ErrorResult("Cannot load an SVG without a width and height."));
+        }
+
+        auto rast = nsvgCreateRasterizer();
+
+        if (rast == nullptr) {
+            return std::shared_ptr<Result>(new ErrorResult(std::string("Failed to create rasterizer SVG.")));
+        }
+
+        if (request->IsDisableDecoderScaling()) {
+            // The crop region alone, at the origin.
+            width = cropWidth;
+            height = cropHeight;
+            source = (unsigned char *)malloc(width*height*requestedComponents);
+
+            if (source == nullptr) {
+                error = "Failed to allocate memory for SVG.";
+            } else {
+                nsvgRasterizeFull(rast, imageSource->GetSvg(), -request->GetCropX(), -request->GetCropY(), 1, 1, source,
+                    width, height, width*requestedComponents);
+            }
+        } else {
+            // Every size is rasterized from the one parsed image, straight at its own scale.
+            for (auto i : order) {
+                auto canvas = canvases[i];
+                auto rowSize = (size_t)canvas->GetWidth()*requestedComponents;
+
+                pixels[i] = (unsigned char *)malloc(rowSize*canvas->GetHeight());
+
+                if (pixels[i] == nullptr) {
+                    error = "Failed to allocate memory for SVG.";
+                    break;
+                }
+
+                if (canvas->IsPad()) {
+                    FillRows(pixels[i], canvas->GetWidth(), canvas->GetHeight(), rowSize, request->GetBackground());
+                }
+
+                nsvgRasterizeFull(rast, imageSource->GetSvg(), -(request->GetCropX() + canvas->GetRegionLeft())*canvas->GetScaleX(),
+                    -(request->GetCropY() + canvas->GetRegionTop())*canvas->GetScaleY(), canvas->GetScaleX(), canvas->GetScaleY(),
+                    pixels[i] + canvas->GetContentOffset(rowSize), canvas->GetContentWidth(), canvas->GetContentHeight(), rowSize);
+
+                if (request->IsPremultiplied()) {
+                    auto content = pixels[i] + canvas->GetContentOffset(rowSize);
+
+                    PremultiplyRGBA8(content, canvas->GetContentWidth(), canvas->GetContentHeight(), rowSize, content,
+                        rowSize);
+                }
+            }
+        }
+
+        nsvgDeleteRasterizer(rast);
+    } else {
+        int components;
+
+        // Every output reads the crop region, so the rows below it are not decoded.
+        if (request->IsCrop()) {
+            stbi_set_row_range_thread(request->GetCropY(), request->GetCropY() + request->GetCropHeight(height));
+        }
+
+        source = stbi_load_from_file(imageSource->GetFile(), &width, &height, &components, requestedComponents);
+        stbi_set_row_range_thread(0, 0);
+        DecodeMemory::ForThread()->Keep(source);
+
+        if (source == nullptr) {
+            return std::shared_ptr<Result>(new ErrorResult(std::string("File load error: ").append(stbi_failure_reason())));
+        }
+    }
+
+    // Resize.
+    if (source && error.empty()) {
+        auto cropped = source;
+        auto sourceStride = (size_t)width*requestedComponents;
+        const unsigned char *previous = nullptr;
+        int previousWidth = 0;
+        int previousHeight = 0;
+
+        if (!imageSource->IsSvg()) {
+            cropped += request->GetCropOffset(width);
+        }
+
+        // Premultiplied once for every output, which then copy or resize the pixels as they are.
+        if (request->IsPremultiplied()) {
+            PremultiplyRGBA8(cropped, cropWidth, cropHeight, sourceStride, cropped, sourceStride);
+        }
+
+        for (auto i : order) {
+            auto canvas = canvases[i];
+            auto rowSize = (size_t)canvas->GetWidth()*requestedComponents;
+
+            pixels[i] = (unsigned char *)malloc(rowSize*canvas->GetHeight());
+
+            if (pixels[i] == nullptr) {
+                error = "Failed to allocate memory for the image.";
+                break;
+            }
+
+            if (canvas->IsPad()) {
+                FillRows(pixels[i], canvas->GetWidth(), canvas->GetHeight(), rowSize, request->GetBackground());
+            }
+
+            if (!canvas->IsResize()) {
+                CopyRows(cropped, sourceStride, pixels[i] + canvas->GetContentOffset(rowSize), rowSize,
+                    (size_t)canvas->GetContentWidth()*requestedComponents, canvas->GetContentHeight());
+            } else {
+                const unsigned char *input = cropped;
+                auto inputWidth = cropWidth;
+                auto inputHeight = cropHeight;
+                auto inputStride = sourceStride;
+
+                // Resizing from the previous output, which is at least as large as this one but smaller than the source, is
+                // cheaper, at some cost in quality. Outputs that crop or pad the image are resized from the source.
+                if (request->IsCascade() && previous && canvas->IsCascadable() && previousWidth >= canvas->GetWidth()
+                        && previousHeight >= canvas->GetHeight()) {
+                    input = previous;
+                    inputWidth = previousWidth;
+                    inputHeight = previousHeight;
+                    inputStride = (size_t)previousWidth*requestedComponents;
+                }
+
+                if (!ResizePixels(input, inputWidth, inputHeight, inputStride,
+                        request->IsPremultiplied() ? canvas->ForPremultipliedSource() : canvas, pixels[i], rowSize,
+                        requestedComponents)) {
+                    error = "Failed to resize the image.";
+                    break;
+                }
+            }
+
+            if (canvas->IsCascadable()) {
+                previous = pixels[i];
+                previousWidth = canvas->GetWidth();
+                previousHeight = canvas->GetHeight();
+            }
+        }
+    }
+
+    free(source);
+
+    if (!error.empty()) {
+        for (auto p : pixels) {
+            free(p);
+        }
+
+        return std::shared_ptr<Result>(new ErrorResult(error));
+    }
+
+    // Colorspace. Runs after every resize, as a cascade reads the outputs before it.
+    for (size_t i = 0; i < outputs.size(); i++) {
+        auto canvas = canvases[i];
+        auto pixelFormat = PIXEL_FORMAT_RGBA;
+
+        if (outputs[i].GetFormat() != PIXEL_FORMAT_UNKNOWN) {
+            pixelFormat = outputs[i].GetFormat();
+            ConvertRows(pixels[i], canvas->GetWidth(), canvas->GetHeight(), (size_t)canvas->GetWidth()*requestedComponents,
+                requestedComponents, pixelFormat);
+        }
+
+        buffers.push_back(std::shared_ptr<BufferResult>(new BufferResult(canvas->GetWidth(), canvas->GetHeight(),
+            GetChannels(pixelFormat), pixelFormat, pixels[i])));
+    }
+
+    return std::shared_ptr<Result>(new BuffersResult(buffers));
+}
+
+std::shared_ptr<Result> PipelineBatch(const std::shared_ptr<Request> request, const std::shared_ptr<ImageSource> imageSource) {
+    auto& batch = request->GetBatch();
+    std::vector<std::shared_ptr<ImageSource>> imageSources;
+    std::vector<std::shared_ptr<Canvas>> canvases;
+    auto closeAll = [&imageSources]() {
+        for (auto source : imageSources) {
+            source->Close();
+        }
+    };
+
+    // Every image has to be the same size before the shared output can be allocated, so all headers are read first.
+    for (size_t i = 0; i < batch.size(); i++) {
+        auto source = (i == 0) ? imageSource : std::shared_ptr<ImageSource>(new ImageSource(batch[i]->GetFilename()));
+        auto item = batch[i];
+
+        imageSources.push_back(source);
+
+        if (!source->IsLoaded() && (!source->Open() || !source->IsLoaded())) {
+            closeAll();
+            return std::shared_ptr<Result>(new ErrorResult(source->GetError()));
+        }
+
+        if (item->IsCrop() && (item->GetCropX() + item->GetCropWidth(0) > source->GetWidth()
+                || item->GetCropY() + item->GetCropHeight(0) > source->GetHeight())) {
+            closeAll();
+            return std::shared_ptr<Result>(new ErrorResult("Crop region is outside of the image."));
+        }
+
+        canvases.push_back(std::shared_ptr<Canvas>(new Canvas(item, item->GetCropWidth(source->GetWidth()),
+            item->GetCropHeight(source->GetHeight()))));
+
+        if (canvases[i]->GetWidth() != canvases[0]->GetWidth() || canvases[i]->GetHeight() != canvases[0]->GetHeight()) {
+            closeAll();
+            return std::shared_ptr<Result>(new ErrorResult("Batch images must all have the same output size."));
+        }
+    }
+
+    auto width = canvases[0]->GetWidth();
+    auto height = canvases[0]->GetHeight();
+    auto channels = 4;
+    auto imageSize = (size_t)width*height*channels;
+    auto length = imageSize*batch.size();
+    auto pixels = (unsigned char *)malloc(length > 0 ? length : 1);
+    auto pixelFormat = PIXEL_FORMAT_RGBA;
+
+    if (pixels == nullptr) {
+        closeAll();
+        return std::shared_ptr<Result>(new ErrorResult(std::string("Failed to allocate memory for the batch.")));
+    }
+
+    // Each image is drawn straight into its layer, as if the layer were a caller supplied target.
+    for (size_t i = 0; i < batch.size(); i++) {
+        auto target = std::shared_ptr<Target>(new Target());
+
+        target->Set(pixels, length, i*imageSize);
+
+        auto result = Pipeline(batch[i], imageSources[i], target);
+
+        if (result->GetType() == ERROR_EVENT_TYPE) {
+            free(pixels);
+            closeAll();
+            return result;
+        }
+
+        pixelFormat = std::static_pointer_cast<TargetResult>(result)->GetFormat();
+        imageSources[i]->Close();
+    }
+
+    return std::shared_ptr<Result>(new BatchResult(width, height, channels, pixelFormat, pixels, batch.size()));
+}
+
+// Images decoded on any number of threads and then packed onto the pages of a texture atlas.
+class Atlas {
+    private:
+        std::vector<std::shared_ptr<Request>> requests;
+        int maxSize;
+        int padding;
+        bool trim;
+        PixelFormat format;
+        // RGBA pixels of each image, until they are drawn to the pages.
+        std::vector<std::shared_ptr<BufferResult>> images;
+        std::atomic<size_t> remaining;
+        std::mutex mutex;
+        std::string error;
+
+    public:
+        // Assume arguments are validated in javascript.
+        Atlas(const Array& requests, const Object& options) : remaining(requests.Length()) {
+            for (uint32_t i = 0; i < requests.Length(); i++) {
+                this->requests.push_back(std::shared_ptr<Request>(new Request(requests.Get(i).As<Object>(), false, false)));
+            }
+
+            this->images.resize(this->requests.size());
+            this->maxSize = options.Get(ATLAS_MAX_SIZE).As<Number>().Int32Value();
+            this->padding = options.Get(ATLAS_PADDING).As<Number>().Int32Value();
+            this->trim = options.Get(ATLAS_TRIM).As<Boolean>().Value();
+            this->format = PixelFormatFromString(options.Get(ATLAS_FORMAT).As<String>().Utf8Value());
+        }
+
+        ~Atlas() {
+            this->DiscardImages();
+        }
+
+        size_t GetCount() const {
+            return this->requests.size();
+        }
+
+        // Any thread. Decodes image i. True for the last image to finish, after which the atlas can be built.
+        bool Decode(const size_t i) {
+            auto request = this->requests[i];
+            auto imageSource = std::shared_ptr<ImageSource>(new ImageSource(request->GetFilename()));
+            std::shared_ptr<Result> result;
+
+            if (!imageSource->IsLoaded() && (!imageSource->Open() || !imageSource->IsLoaded())) {
+                result = std::shared_ptr<Result>(new ErrorResult(imageSource->GetError()));
+            } else {
+                result = Pipeline(request, imageSource, std::shared_ptr<Target>(new Target()));
+            }
+
+            imageSource->Close();
+
+            if (result->GetType() == ERROR_EVENT_TYPE) {
+                std::lock_guard<std::mutex> lock(this->mutex);
+
+                // The first failure is the one reported.
+                if (this->error.empty()) {
+                    this->error = std::static_pointer_cast<ErrorResult>(result)->GetError();
+                }
+            } else {
+                this->images[i] = std::static_pointer_cast<BufferResult>(result);
+            }
+
+            return --this->remaining == 0;
+        }
+
+        // Packs the decoded images and draws them onto the pages. Any thread, once every image is decoded.
+        std::shared_ptr<Result> Build() {
+            if (!this->error.empty()) {
+                return std::shared_ptr<Result>(new ErrorResult(this->error));
+            }
+
+            std::vector<AtlasRect> rects;
+            std::vector<AtlasFrame> frames;
+            std::vector<int> lefts;
+            std::vector<int> tops;
+
+            for (auto& image : this->images) {
+                auto left = 0;
+                auto top = 0;
+                auto right = image->GetWidth();
+                auto bottom = image->GetHeight();
+
+                // A transparent image keeps one pixel, so it still has a frame to point at.
+                if (this->trim && !FindAlphaBounds(image->GetPixels(), image->GetWidth(), image->GetHeight(),
+                        (size_t)image->GetWidth()*4, &left, &top, &right, &bottom)) {
+                    right = bottom = 1;
+                }
+
+                rects.push_back(AtlasRect(right - left, bottom - top));
+                lefts.push_back(left);
+                tops.push_back(top);
+            }
+
+            AtlasPacker packer(this->maxSize, this->padding);
+
+            if (!packer.Pack(rects)) {
+                return std::shared_ptr<Result>(new ErrorResult("Image is larger than the atlas page size."));
+            }
+
+            std::vector<unsigned char *> pixels;
+
+            for (int i = 0; i < packer.GetPageCount(); i++) {
+                // Padding and the space around trimmed images stay transparent.
+                auto page = (unsigned char *)calloc((size_t)packer.GetPageWidth(i)*packer.GetPageHeight(i), 4);
+
+                if (page == nullptr) {
+                    for (auto previous : pixels) {
+                        free(previous);
+                    }
+
+                    return std::shared_ptr<Result>(new ErrorResult(std::string("Failed to allocate memory for the atlas.")));
+                }
+
+                pixels.push_back(page);
+            }
+
+            for (size_t i = 0; i < rects.size(); i++) {
+                auto& rect = rects[i];
+                auto& image = this->images[i];
+                auto stride = (size_t)image->GetWidth()*4;
+                auto pageStride = (size_t)packer.GetPageWidth(rect.GetPage())*4;
+
+                CopyRows(image->GetPixels() + (size_t)tops[i]*stride + (size_t)lefts[i]*4, stride,
+                    pixels[rect.GetPage()] + (size_t)rect.GetY()*pageStride + (size_t)rect.GetX()*4, pageStride,
+                    (size_t)rect.GetWidth()*4, rect.GetHeight());
+                frames.push_back(AtlasFrame(rect, lefts[i], tops[i], image->GetWidth(), image->GetHeight()));
+            }
+
+            this->DiscardImages();
+
+            std::vector<std::shared_ptr<BufferResult>> pages;
+
+            for (int i = 0; i < packer.GetPageCount(); i++) {
+                auto width = packer.GetPageWidth(i);
+                auto height = packer.GetPageHeight(i);
+
+                if (this->format != PIXEL_FORMAT_UNKNOWN) {
+                    ConvertRows(pixels[i], width, height, (size_t)width*4, 4, this->format);
+                }
+
+                pages.push_back(std::shared_ptr<BufferResult>(new BufferResult(width, height, 4,
+                    this->format != PIXEL_FORMAT_UNKNOWN ? this->format : PIXEL_FORMAT_RGBA, pixels[i])));
+            }
+
+            return std::shared_ptr<Result>(new AtlasResult(pages, frames));
+        }
+
+    private:
+        void DiscardImages() {
+            for (auto& image : this->images) {
+                if (image) {
+                    image->Discard();
+                    image = nullptr;
+                }
+            }
+        }
+};
+
+Value NewSharedBuffer(Env env, size_t size) {
+    auto global = env.Global();
+    auto sharedArrayBuffer = global.Get("SharedArrayBuffer");
+
+    if (!sharedArrayBuffer.IsFunction()) {
+        throw Error::New(env, "SharedArrayBuffer is not available.");
+    }
+
+    auto buffer = sharedArrayBuffer.As<Function>().New({ Number::New(env, size) });
+
+    return global.Get("Uint8Array").As<Function>().New({ buffer });
+}
+
+void RunJob(const std::shared_ptr<Job> job) {
+    GetThreadPool().push([job](int id) {
+        std::shared_ptr<Result> result;
+
+        // Only the final result goes back to javascript, unless the main thread has to step in before the job can
+        // continue, or the result is a frame. The header produced on the way to a buffer stays here.
+        while (true) {
+            if (job->cancelled) {
+                result = std::shared_ptr<Result>(new ErrorResult("Cancelled."));
+                job->imageSource->Close();
+                break;
+            }
+
+            result = Pipeline(job->request, job->imageSource, job->target);
 
-        stbir_filter GetStbFilter() const {
-            return this->filter;
+            if (result->IsFinal()) {
+                job->imageSource->Close();
+                break;
+            } else if (result->GetType() == ALLOCATION_EVENT_TYPE) {
+                break;
+            } else if (result->GetType() == BUFFER_EVENT_TYPE) {
+                // Frames go out as they are decoded, so playback can start before the last one is ready.
+                job->completionQueue->Push(new JobCompletion(job, result));
+            }
         }
 
-        bool IsResize() const {
-            return this->resize;
+        // Hand the result to the main thread without waiting for it to run.
+        job->completionQueue->Push(new JobCompletion(job, result));
+    });
+}
+
+void JobCompletion::Complete(napi_env env) {
+    // The promise can no longer be settled when the environment is being torn down.
+    if (env == nullptr) {
+        // A job waiting on its allocation is parked with the source open, and will not run again to close it. Jobs that
+        // sent anything else have closed it, or are still decoding.
+        if (this->result->GetType() == ALLOCATION_EVENT_TYPE) {
+            this->job->imageSource->Close();
         }
-};
 
-std::string PixelFormatToString(const PixelFormat pixelFormat) {
-    switch(pixelFormat) {
-        case PIXEL_FORMAT_RGBA:
-            return "rgba";
-        case PIXEL_FORMAT_ABGR:
-            return "abgr";
-        case PIXEL_FORMAT_ARGB:
-            return "argb";
-        case PIXEL_FORMAT_BGRA:
-            return "bgra";
-        case PIXEL_FORMAT_RGB:
-            return "rgb";
-        default:
-            return "";
+        this->Discard();
+        return;
     }
-}
 
-PixelFormat PixelFormatFromString(const std::string& str) {
-    if (str == "rgba") {
-        return PIXEL_FORMAT_RGBA;
-    } else if (str == "argb") {
-        return PIXEL_FORMAT_ARGB;
-    } else if (str == "abgr") {
-        return PIXEL_FORMAT_ABGR;
-    } else if (str == "bgra") {
-        return PIXEL_FORMAT_BGRA;
+    if (!this->result->IsFinal() && this->result->GetType() == BUFFER_EVENT_TYPE) {
+        this->CompleteFrame(Env(env));
+        return;
     }
 
-    return PIXEL_FORMAT_UNKNOWN;
-}
+    auto resolve = this->result->GetType() != ERROR_EVENT_TYPE;
+    Value value;
 
-int GetChannels(const PixelFormat pixelFormat) {
-    switch(pixelFormat) {
-        case PIXEL_FORMAT_RGBA:
-        case PIXEL_FORMAT_ABGR:
-        case PIXEL_FORMAT_ARGB:
-        case PIXEL_FORMAT_BGRA:
-            return 4;
-        case PIXEL_FORMAT_RGB:
-            return 3;
-        default:
-            return -1;
+    // Identical loads from now on start a job of their own.
+    if (!this->job->key.empty()) {
+        Addon::Get(env)->coalescedJobs.erase(this->job->key);
     }
-}
 
-int IsBigEndian() {
-    int i = 1;
-    return ! *((char *)&i);
-}
+    if (!this->job->settled) {
+        try {
+            if (this->result->GetType() == ALLOCATION_EVENT_TYPE) {
+                this->job->target->Set(env, NewSharedBuffer(env, std::static_pointer_cast<AllocationResult>(this->result)->GetSize()));
+                RunJob(this->job);
+                return;
+            }
 
-bool CompletionFunction(const Value& val) {
-    return val.As<Boolean>().Value();
-}
+            if (!this->job->bulk) {
+                value = this->result->ToValue(env);
+            }
+        } catch (const Error& e) {
+            value = e.Value();
+            resolve = false;
+        }
 
-PixelFormat GetPixelFormatFromComponent(int component) {
-    return (component == 3) ?  PIXEL_FORMAT_RGB : PIXEL_FORMAT_RGBA;
-}
+        // The job ends here when its allocation failed.
+        if (this->result->GetType() == ALLOCATION_EVENT_TYPE) {
+            this->job->imageSource->Close();
+        }
 
-void ConvertPixelsLE(unsigned char *bytes, int len, int bytesPerPixel, PixelFormat format) {
-    auto i = 0;
-    unsigned char r, g, b, a;
+        if (this->job->bulk) {
+            // The bulk load settles once, with every result. Only a shared allocation that failed has a value here.
+            this->job->bulk->Add(Env(env), this->job->index, value.IsEmpty() ? this->result
+                : std::shared_ptr<Result>(new ErrorResult(Error(env, value).Message())), this->job->target);
+        } else if (resolve) {
+            napi_resolve_deferred(env, this->job->deferred, value);
+        } else {
+            napi_reject_deferred(env, this->job->deferred, value);
+        }
 
-    while (i < len) {
-        r = bytes[i];
-        g = bytes[i + 1];
-        b = bytes[i + 2];
-        a = (bytesPerPixel == 4) ? bytes[i + 3] : 255;
+        // Each joined caller gets a buffer of its own over the same pixels.
+        for (auto waiter : this->job->waiters) {
+            auto waiterResolve = resolve;
+            auto waiterValue = value;
+
+            if (resolve) {
+                try {
+                    waiterValue = this->result->ToValue(env);
+                } catch (const Error& e) {
+                    waiterValue = e.Value();
+                    waiterResolve = false;
+                }
+            }
 
-        switch(format) {
-            case PIXEL_FORMAT_RGBA:
-                bytes[i    ] = a;
-                bytes[i + 1] = b;
-                bytes[i + 2] = g;
-                bytes[i + 3] = r;
-                break;
-            case PIXEL_FORMAT_ABGR:
-                bytes[i    ] = r;
-                bytes[i + 1] = g;
-                bytes[i + 2] = b;
-                bytes[i + 3] = a;
-                break;
-            case PIXEL_FORMAT_ARGB:
-                bytes[i    ] = b;
-                bytes[i + 1] = g;
-                bytes[i + 2] = r;
-                bytes[i + 3] = a;
-                break;
-            case PIXEL_FORMAT_BGRA:
-                bytes[i    ] = a;
-                bytes[i + 1] = r;
-                bytes[i + 2] = g;
-                bytes[i + 3] = b;
-                break;
-            case PIXEL_FORMAT_RGB:
-                bytes[i    ] = b;
-                bytes[i + 1] = g;
-                bytes[i + 2] = r;
-                break;
-            default:
-                break;
+            if (waiterResolve) {
+                napi_resolve_deferred(env, waiter, waiterValue);
+            } else {
+                napi_reject_deferred(env, waiter, waiterValue);
+            }
         }
+    }
 
-        i += bytesPerPixel;
+    // The bulk load releases the targets of its jobs once it has read their results.
+    if (!this->job->bulk) {
+        this->job->Release(Env(env));
     }
-}
 
-void ConvertPixelsBE(unsigned char *bytes, int len, int bytesPerPixel, PixelFormat format) {
-    auto i = 0;
-    unsigned char r, g, b, a;
+    this->job->completionQueue->Unref(env);
+}
 
-    while (i < len) {
-        r = bytes[i];
-        g = bytes[i + 1];
-        b = bytes[i + 2];
-        a = (bytesPerPixel == 4) ? bytes[i + 3] : 255;
+void JobCompletion::CompleteFrame(Env env) {
+    napi_value onFrame;
 
-        switch(format) {
-            case PIXEL_FORMAT_RGBA:
-                bytes[i    ] = r;
-                bytes[i + 1] = g;
-                bytes[i + 2] = b;
-                bytes[i + 3] = a;
-                break;
-            case PIXEL_FORMAT_ABGR:
-                bytes[i    ] = a;
-                bytes[i + 1] = b;
-                bytes[i + 2] = g;
-                bytes[i + 3] = r;
-                break;
-            case PIXEL_FORMAT_ARGB:
-                bytes[i    ] = a;
-                bytes[i + 1] = r;
-                bytes[i + 2] = g;
-                bytes[i + 3] = b;
-                break;
-            case PIXEL_FORMAT_BGRA:
-                bytes[i    ] = b;
-                bytes[i + 1] = g;
-                bytes[i + 2] = r;
-                bytes[i + 3] = a;
-                break;
-            case PIXEL_FORMAT_RGB:
-                bytes[i    ] = r;
-                bytes[i + 1] = g;
-                bytes[i + 2] = b;
-                break;
-            default:
-                break;
-        }
+    if (this->job->settled || napi_get_reference_value(env, this->job->onFrame, &onFrame) != napi_ok) {
+        this->Discard();
+        return;
+    }
 
-        i += bytesPerPixel;
+    try {
+        Function(env, onFrame).Call({ this->result->ToValue(env) });
+    } catch (const Error& e) {
+        // A throwing callback ends the animation. The promise rejects with what it threw.
+        this->job->cancelled = true;
+        this->job->settled = true;
+        napi_reject_deferred(env, this->job->deferred, e.Value());
     }
 }
 
-void AddBufferAllocation(void *bufferData) {
-    sBufferAllocations.insert(bufferData);
+void JobCompletion::Discard() {
+    this->result->Discard();
 }
 
-void ReleaseBufferAllocation(void *bufferData) {
-    auto it = sBufferAllocations.find(bufferData);
-
-    if (it != sBufferAllocations.end()) {
-        free(bufferData);
-        sBufferAllocations.erase(it);
+// A compiled request is used for the source after the other arguments instead of being read from javascript again.
+std::shared_ptr<Request> NewRequest(const CallbackInfo& info) {
+    if (info[0].IsExternal()) {
+        return info[0].As<External<Request>>().Data()->WithSource(info[4].As<String>().Utf8Value());
     }
-}
 
-float ScaleFactor(const int source, const int dest) {
-    return 1.f + (((float)dest - (float)source) / (float)source);
+    return std::shared_ptr<Request>(new Request(info));
 }
 
-std::shared_ptr<Result> Pipeline(const std::shared_ptr<Request> request, const std::shared_ptr<ImageSource> imageSource) {
-    // Header.
-    if (!imageSource->IsLoaded()) {
-        if (!imageSource->Open() || !imageSource->IsLoaded()) {
-            return std::shared_ptr<Result>(new ErrorResult(imageSource->GetError()));
-        }
+Value CompilePipeline(const CallbackInfo& info) {
+    // Assume arguments are validated in javascript.
+    auto request = new Request(info[0].As<Object>(), false, false);
 
-        return std::shared_ptr<Result>(new HeaderResult(imageSource->GetWidth(), imageSource->GetHeight(), 4, request->IsHeaderQuery()));
-    }
+    return External<Request>::New(info.Env(), request, [](Env env, Request *request) {
+        delete request;
+    });
+}
 
-    auto width = imageSource->GetWidth();
-    auto height = imageSource->GetHeight();
-    auto pixelFormat = PIXEL_FORMAT_RGBA;
-    auto requestedComponents = 4;
-    unsigned char *pixels = nullptr;
-    auto canvas = std::shared_ptr<Canvas>(new Canvas(request, width, height));
+Value LoadPipeline(const CallbackInfo& info) {
+    // Assume arguments are validated in javascript.
+    auto env = info.Env();
+    auto job = std::shared_ptr<Job>(new Job());
+    napi_value promise;
 
-    // Load Image Data.
-    if (imageSource->IsSvg()) {
-        if (width <= 0 || height <= 0) {
-            return std::shared_ptr<Result>(new ErrorResult("Cannot load an SVG without a width and height."));
-        }
+    job->request = NewRequest(info);
+    job->imageSource = std::shared_ptr<ImageSource>(new ImageSource(job->request->GetFilename()));
+    job->target = std::shared_ptr<Target>(new Target());
+    job->completionQueue = Addon::Get(env)->completionQueue;
 
-        auto rast = nsvgCreateRasterizer();
+    if (info[2].IsObject()) {
+        job->target->Set(env, info[2].As<Object>());
+    }
 
-        if (rast == nullptr) {
-            return std::shared_ptr<Result>(new ErrorResult(std::string("Failed to create rasterizer SVG.")));
-        }
+    if (job->request->IsAnimation() && napi_create_reference(env, info[3], 1, &job->onFrame) != napi_ok) {
+        job->Release(env);
+        throw Error::New(env, "Failed to reference frame callback.");
+    }
 
-        float scaleX;
-        float scaleY;
+    if (napi_create_promise(env, &job->deferred, &promise) != napi_ok) {
+        job->Release(env);
+        Napi::Error::New(env, "Failed to create promise.").ThrowAsJavaScriptException();
+        return env.Null();
+    }
 
-        if (request->IsDisableDecoderScaling()) {
-            scaleX = 1;
-            scaleY = 1;
-        } else {
-            scaleX = canvas->GetScaleX();
-            scaleY = canvas->GetScaleY();
-            width = canvas->GetWidth();
-            height = canvas->GetHeight();
-            pixels = (unsigned char *)malloc(width*height*requestedComponents);
-        }
+    // A load identical to one in flight waits for that one's result instead of decoding the file again. Loads into a
+    // target write to memory of their own, so they always run.
+    if (!job->target->IsSet()) {
+        auto& coalescedJobs = Addon::Get(env)->coalescedJobs;
 
-        pixels = (unsigned char *)malloc(width*height*requestedComponents);
+        job->key = job->request->GetKey();
 
-        if (pixels == nullptr) {
-            nsvgDeleteRasterizer(rast);
-            return std::shared_ptr<Result>(new ErrorResult(std::string("Failed to allocate memory for SVG.")));
-        }
+        if (!job->key.empty()) {
+            auto it = coalescedJobs.find(job->key);
 
-        nsvgRasterizeFull(rast, imageSource->GetSvg(), 0, 0, scaleX, scaleY, pixels, width, height, width*requestedComponents);
-        nsvgDeleteRasterizer(rast);
-    } else {
-        int components;
-        
-        pixels = stbi_load_from_file(imageSource->GetFile(), &width, &height, &components, requestedComponents);
+            if (it != coalescedJobs.end()) {
+                it->second->waiters.push_back(job->deferred);
+                return Value(env, promise);
+            }
 
-        if (pixels == nullptr) {
-            return std::shared_ptr<Result>(new ErrorResult(std::string("File load error: ").append(stbi_failure_reason())));
+            coalescedJobs[job->key] = job;
         }
     }
 
-    // Resize.
-    if (canvas->IsResize() && !(imageSource->IsSvg() && !request->IsDisableDecoderScaling())) {
-        auto alphaChannelIndex = IsBigEndian() ? 3 : 0;
-        auto output = (unsigned char *)malloc(canvas->GetWidth()*canvas->GetHeight()*requestedComponents);
-
-        auto result = stbir_resize_uint8_generic(
-            // input
-            pixels,
-            width,
-            height,
-            0,
-            // output
-            output,
-            canvas->GetWidth(),
-            canvas->GetHeight(),
-            0,
-            // channels
-            requestedComponents,
-            alphaChannelIndex,
-            // settings
-            0,
-            STBIR_EDGE_CLAMP,
-            canvas->GetStbFilter(),
-            STBIR_COLORSPACE_LINEAR,
-            // context
-            nullptr
-        );
+    job->completionQueue->Ref(env);
+    RunJob(job);
 
-        if (!result) {
-            free(pixels);
-            free(output);
-            return std::shared_ptr<Result>(new ErrorResult(std::string("Failed to resize the image.")));
-        }
+    return Value(env, promise);
+}
 
-        free(pixels);
-        pixels = output;
-        width = canvas->GetWidth();
-        height = canvas->GetHeight();
+Value LoadPipelines(const CallbackInfo& info) {
+    // Assume arguments are validated in javascript.
+    auto env = info.Env();
+    auto sources = info[1].As<Array>();
+    auto ordered = info[2].As<Boolean>().Value();
+    auto request = info[0].IsExternal()
+        ? info[0].As<External<Request>>().Data()->WithSource("")
+        : std::shared_ptr<Request>(new Request(info[0].As<Object>(), false, false));
+    auto completionQueue = Addon::Get(env)->completionQueue;
+    napi_deferred deferred;
+    napi_value promise;
+
+    if (napi_create_promise(env, &deferred, &promise) != napi_ok) {
+        Napi::Error::New(env, "Failed to create promise.").ThrowAsJavaScriptException();
+        return env.Null();
     }
 
-    // Colorspace.
-    if (request->GetFormat() != PIXEL_FORMAT_UNKNOWN) {
-        if (IsBigEndian()) {
-            ConvertPixelsBE(pixels, width*height*requestedComponents, requestedComponents, request->GetFormat());
-        } else {
-            ConvertPixelsLE(pixels, width*height*requestedComponents, requestedComponents, request->GetFormat());
-        }
-        pixelFormat = request->GetFormat();
+    auto bulk = std::shared_ptr<BulkJob>(new BulkJob(deferred, sources.Length(), ordered));
+
+    if (sources.Length() == 0) {
+        napi_resolve_deferred(env, deferred, Array::New(env));
+        return Value(env, promise);
     }
 
-    return std::shared_ptr<Result>(new BufferResult(width, height, GetChannels(pixelFormat), pixelFormat, pixels));
+    // Every source is queued on the pool before returning, reading the request once for all of them.
+    for (uint32_t i = 0; i < sources.Length(); i++) {
+        auto job = std::shared_ptr<Job>(new Job());
+
+        job->bulk = bulk;
+        job->index = i;
+        job->request = request->WithSource(sources.Get(i).As<String>().Utf8Value());
+        job->imageSource = std::shared_ptr<ImageSource>(new ImageSource(job->request->GetFilename()));
+        job->target = std::shared_ptr<Target>(new Target());
+        job->completionQueue = completionQueue;
+
+        completionQueue->Ref(env);
+        RunJob(job);
+    }
+
+    return Value(env, promise);
 }
 
-void LoadPipeline(const CallbackInfo& info) {
+Value LoadAtlas(const CallbackInfo& info) {
     // Assume arguments are validated in javascript.
-    auto request = std::shared_ptr<Request>(new Request(info));
-    auto callback = std::make_shared<ThreadSafeCallback>(info[2].As<Function>());
+    auto env = info.Env();
+    auto atlas = std::shared_ptr<Atlas>(new Atlas(info[0].As<Array>(), info[1].As<Object>()));
+    auto job = std::shared_ptr<Job>(new Job());
+    napi_value promise;
 
-    GetThreadPool().push([request, callback](int id) {
-        auto imageSource = std::shared_ptr<ImageSource>(new ImageSource(request->GetFilename()));
+    job->target = std::shared_ptr<Target>(new Target());
+    job->completionQueue = Addon::Get(env)->completionQueue;
 
-        while (true) {
-            std::shared_ptr<Result> result = Pipeline(request, imageSource);
+    if (napi_create_promise(env, &job->deferred, &promise) != napi_ok) {
+        Napi::Error::New(env, "Failed to create promise.").ThrowAsJavaScriptException();
+        return env.Null();
+    }
 
-            callback->call<bool>([result](Napi::Env env, std::vector<napi_value>& args) {
-                args.push_back(String::New(env, result->GetType()));
-                args.push_back(result->ToValue(env));
-            },
-            CompletionFunction);
+    job->completionQueue->Ref(env);
 
-            if (result->IsFinal()) {
-                break;
+    // Every image is decoded on the pool at once. The last one to finish packs the atlas on its thread, so the main
+    // thread only receives the pages.
+    for (size_t i = 0; i < atlas->GetCount(); i++) {
+        GetThreadPool().push([atlas, job, i](int id) {
+            if (atlas->Decode(i)) {
+                job->completionQueue->Push(new JobCompletion(job, atlas->Build()));
             }
-        }
+        });
+    }
 
-        imageSource->Close();
-    });
+    return Value(env, promise);
+}
+
+Value LoadAtlasSync(const CallbackInfo& info) {
+    // Assume arguments are validated in javascript.
+    auto env = info.Env();
+    Atlas atlas(info[0].As<Array>(), info[1].As<Object>());
+
+    for (size_t i = 0; i < atlas.GetCount(); i++) {
+        atlas.Decode(i);
+    }
+
+    auto result = atlas.Build();
+
+    if (result->GetType() == ERROR_EVENT_TYPE) {
+        Napi::Error::New(env, std::static_pointer_cast<ErrorResult>(result)->GetError()).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    return result->ToValue(env);
 }
 
 Value LoadPipelineSync(const CallbackInfo& info) {
     // Assume arguments are validated in javascript.
     auto env = info.Env();
-    auto request = std::shared_ptr<Request>(new Request(info));
+    auto request = NewRequest(info);
     auto imageSource = std::shared_ptr<ImageSource>(new ImageSource(request->GetFilename()));
+    auto target = std::shared_ptr<Target>(new Target());
     Value returnValue;
 
+    if (info[2].IsObject()) {
+        target->Set(env, info[2].As<Object>());
+    }
+
     while (true) {
-        std::shared_ptr<Result> result = Pipeline(request, imageSource);
+        std::shared_ptr<Result> result = Pipeline(request, imageSource, target);
 
-        returnValue = result->ToValue(env);
+        if (result->GetType() == ALLOCATION_EVENT_TYPE) {
+            target->Set(env, NewSharedBuffer(env, std::static_pointer_cast<AllocationResult>(result)->GetSize()));
+            continue;
+        }
 
-        if (result->GetType() == "error") {
+        if (result->GetType() == ERROR_EVENT_TYPE) {
+            imageSource->Close();
+            target->Release(env);
             Napi::Error::New(env, std::static_pointer_cast<ErrorResult>(result)->GetError()).ThrowAsJavaScriptException();
             return env.Null();
         }
 
         if (result->IsFinal()) {
+            returnValue = result->ToValue(env);
             break;
         }
+
+        if (result->GetType() == BUFFER_EVENT_TYPE) {
+            try {
+                info[3].As<Function>().Call({ result->ToValue(env) });
+            } catch (const Error&) {
+                imageSource->Close();
+                target->Release(env);
+                throw;
+            }
+        }
     }
 
     imageSource->Close();
+    target->Release(env);
 
     return returnValue;
 }
@@ -10,7 +10,11 @@
 
 #include <napi.h>
 
-void LoadPipeline(const Napi::CallbackInfo& info);
+Napi::Value LoadPipeline(const Napi::CallbackInfo& info);
 Napi::Value LoadPipelineSync(const Napi::CallbackInfo& info);
+Napi::Value CompilePipeline(const Napi::CallbackInfo& info);
+Napi::Value LoadPipelines(const Napi::CallbackInfo& info);
+Napi::Value LoadAtlas(const Napi::CallbackInfo& info);
+Napi::Value LoadAtlasSync(const Napi::CallbackInfo& info);
 
 #endif
@@ -0,0 +1,626 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+#include "Resample.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// SSE2 and NEON are part of the x86-64 and arm64 baselines, so the vector paths need neither build flags nor runtime
+// checks. Other targets take the portable loops, which compute the same results.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RESAMPLE_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define RESAMPLE_NEON
+#include <arm_neon.h>
+#endif
+
+// Channel values enter the horizontal pass scaled to 0 - 255*255: color times alpha when alpha weighted, alpha or
+// unweighted colors times 255. They are stored as int16 less 32768, so that 16 bit multiplies with the weights cover
+// the whole range. As the weights of an output pixel add up to RESAMPLE_ONE, the sum is off by exactly 32768 ones,
+// which the rounding constant gives back. Horizontally resampled rows keep a quarter of the scale, leaving int16 room
+// for filters that overshoot, and the vertical pass shifts two bits less to return to 0 - 255*255.
+#define RESAMPLE_ONE (1 << RESAMPLE_WEIGHT_BITS)
+#define RESAMPLE_OFFSET 32768
+#define RESAMPLE_ROW_SHIFT (RESAMPLE_WEIGHT_BITS + 2)
+#define RESAMPLE_ROW_ROUND ((RESAMPLE_OFFSET << RESAMPLE_WEIGHT_BITS) + (1 << (RESAMPLE_ROW_SHIFT - 1)))
+#define RESAMPLE_SUM_SHIFT (RESAMPLE_WEIGHT_BITS - 2)
+#define RESAMPLE_SUM_ROUND (1 << (RESAMPLE_SUM_SHIFT - 1))
+#define RESAMPLE_MAX_VALUE (255*255)
+
+ResampleAxis::ResampleAxis(const int inputSize, const int outputSize, const int taps, const int *first,
+        const float *weights) {
+    this->inputSize = inputSize;
+    this->outputSize = outputSize;
+    this->taps = taps;
+    this->stride = (taps + 1) & ~1;
+    this->first.assign(first, first + outputSize);
+    this->weights.assign((size_t)outputSize*this->stride, 0);
+
+    for (int i = 0; i < outputSize; i++) {
+        auto source = weights + (size_t)i*taps;
+        auto dest = this->weights.data() + (size_t)i*this->stride;
+        auto total = 0.f;
+        auto sum = 0;
+        auto largest = 0;
+
+        for (int k = 0; k < taps; k++) {
+            total += source[k];
+
+            if (fabsf(source[k]) > fabsf(source[largest])) {
+                largest = k;
+            }
+        }
+
+        if (total == 0) {
+            total = 1;
+        }
+
+        auto weight = [](const long value) {
+            return (int16_t)std::min(std::max(value, -32767L), 32767L);
+        };
+
+        for (int k = 0; k < taps; k++) {
+            dest[k] = weight(lroundf(source[k] / total * RESAMPLE_ONE));
+            sum += dest[k];
+        }
+
+        // Rounding error goes to the largest weight, where it matters least.
+        dest[largest] = weight(dest[largest] + RESAMPLE_ONE - sum);
+    }
+}
+
+size_t ResampleScratchSize(const ResampleAxis& horizontal, const ResampleAxis& vertical) {
+    auto rowLength = (size_t)horizontal.GetOutputSize()*4;
+    auto taps = (size_t)vertical.GetTaps();
+
+    return sizeof(int16_t *)*(taps + 1) + sizeof(int)*taps
+        + sizeof(int16_t)*(taps + 1 + rowLength*taps + ((size_t)horizontal.GetInputSize() + 1)*4);
+}
+
+static inline void ExpandPixel(const unsigned char *pixel, const bool alphaWeighted, int16_t *expanded) {
+    auto alpha = alphaWeighted ? pixel[3] : 255;
+
+    expanded[0] = (int16_t)(pixel[0]*alpha - RESAMPLE_OFFSET);
+    expanded[1] = (int16_t)(pixel[1]*alpha - RESAMPLE_OFFSET);
+    expanded[2] = (int16_t)(pixel[2]*alpha - RESAMPLE_OFFSET);
+    expanded[3] = (int16_t)(pixel[3]*255 - RESAMPLE_OFFSET);
+}
+
+static void ExpandRow(const unsigned char *pixels, const int width, const bool alphaWeighted, int16_t *expanded) {
+    auto x = 0;
+
+#if defined(RESAMPLE_SSE2)
+    // Products up to 255*255 fill the low 16 bits of the multiply, and flipping the top bit takes off 32768.
+    auto zero = _mm_setzero_si128();
+    auto offset = _mm_set1_epi16(-RESAMPLE_OFFSET);
+    auto alphaLanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    auto alphaScale = _mm_and_si128(alphaLanes, _mm_set1_epi16(255));
+
+    auto scale = [&](const __m128i v) {
+        if (!alphaWeighted) {
+            return _mm_set1_epi16(255);
+        }
+
+        auto alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xFF), 0xFF);
+
+        return _mm_or_si128(_mm_andnot_si128(alphaLanes, alpha), alphaScale);
+    };
+
+    for (; x + 4 <= width; x += 4, pixels += 16, expanded += 16) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels));
+        auto lo = _mm_unpacklo_epi8(v, zero);
+        auto hi = _mm_unpackhi_epi8(v, zero);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(expanded), _mm_xor_si128(_mm_mullo_epi16(lo, scale(lo)), offset));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(expanded + 8),
+            _mm_xor_si128(_mm_mullo_epi16(hi, scale(hi)), offset));
+    }
+#elif defined(RESAMPLE_NEON)
+    auto offset = vdupq_n_u16(RESAMPLE_OFFSET);
+    auto opaque = vdup_n_u8(255);
+
+    for (; x + 8 <= width; x += 8, pixels += 32, expanded += 32) {
+        auto v = vld4_u8(pixels);
+        auto scale = alphaWeighted ? v.val[3] : opaque;
+        uint16x8x4_t e;
+
+        e.val[0] = veorq_u16(vmull_u8(v.val[0], scale), offset);
+        e.val[1] = veorq_u16(vmull_u8(v.val[1], scale), offset);
+        e.val[2] = veorq_u16(vmull_u8(v.val[2], scale), offset);
+        e.val[3] = veorq_u16(vmull_u8(v.val[3], opaque), offset);
+        vst4q_u16(reinterpret_cast<uint16_t *>(expanded), e);
+    }
+#endif
+
+    for (; x < width; x++, pixels += 4, expanded += 4) {
+        ExpandPixel(pixels, alphaWeighted, expanded);
+    }
+}
+
+static inline int16_t SaturateInt16(const int32_t x) {
+    return (int16_t)std::min(std::max(x, -32768), 32767);
+}
+
+// Taps are taken in pairs, the zero weight padding an odd count reading the pixel after the last tap, which the
+// expanded row provides.
+static void ResampleRow(const int16_t *expanded, const ResampleAxis& axis, int16_t *row) {
+    auto taps = axis.GetTaps();
+
+    for (int x = 0; x < axis.GetOutputSize(); x++, row += 4) {
+        auto source = expanded + (size_t)axis.GetFirst(x)*4;
+        auto weights = axis.GetWeights(x);
+
+#if defined(RESAMPLE_SSE2)
+        auto sum = _mm_set1_epi32(RESAMPLE_ROW_ROUND);
+
+        for (int k = 0; k < taps; k += 2, source += 8) {
+            // Interleaving the channels of two pixels lines them up with their pair of weights for a multiply-add.
+            auto pair = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source));
+            int32_t weightPair;
+
+            memcpy(&weightPair, weights + k, 4);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi16(pair, _mm_srli_si128(pair, 8)),
+                _mm_set1_epi32(weightPair)));
+        }
+
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(row),
+            _mm_packs_epi32(_mm_srai_epi32(sum, RESAMPLE_ROW_SHIFT), _mm_setzero_si128()));
+#elif defined(RESAMPLE_NEON)
+        auto sum = vdupq_n_s32(RESAMPLE_ROW_ROUND);
+
+        for (int k = 0; k < taps; k += 2, source += 8) {
+            auto pair = vld1q_s16(source);
+
+            sum = vmlal_n_s16(sum, vget_low_s16(pair), weights[k]);
+            sum = vmlal_n_s16(sum, vget_high_s16(pair), weights[k + 1]);
+        }
+
+        vst1_s16(row, vqmovn_s32(vshrq_n_s32(sum, RESAMPLE_ROW_SHIFT)));
+#else
+        int32_t sum[4] = { RESAMPLE_ROW_ROUND, RESAMPLE_ROW_ROUND, RESAMPLE_ROW_ROUND, RESAMPLE_ROW_ROUND };
+
+        for (int k = 0; k < taps; k++, source += 4) {
+            for (int c = 0; c < 4; c++) {
+                sum[c] += weights[k]*source[c];
+            }
+        }
+
+        for (int c = 0; c < 4; c++) {
+            row[c] = SaturateInt16(sum[c] >> RESAMPLE_ROW_SHIFT);
+        }
+#endif
+    }
+}
+
+// Rounded x / 255 for x from 0 to 255*255, without a division. It only grows with x beyond that range, so clamping
+// the result is the same as clamping x.
+static inline int DivideBy255(const int x) {
+    return (x + 128 + ((x + 128) >> 8)) >> 8;
+}
+
+// Writes a pixel from sums in the 0 - 255*255 scale. Filters with negative lobes can overshoot, so colors are divided
+// by the alpha sum before either is clamped, as a float resize does.
+static inline void WritePixel(const int32_t *values, const bool unpremultiply, unsigned char *output) {
+    auto alpha = values[3];
+
+    for (int c = 0; c < 3; c++) {
+        auto color = unpremultiply
+            ? (alpha > 0 ? (int)lrintf((float)(values[c]*255) / (float)alpha) : 0)
+            : DivideBy255(values[c]);
+
+        output[c] = (unsigned char)std::min(std::max(color, 0), 255);
+    }
+
+    output[3] = (unsigned char)std::min(std::max(DivideBy255(alpha), 0), 255);
+}
+
+static inline int32_t ColumnSum(const int16_t *const *rows, const int16_t *weights, const int count, const size_t i) {
+    int32_t sum = RESAMPLE_SUM_ROUND;
+
+    for (int k = 0; k < count; k++) {
+        sum += weights[k]*rows[k][i];
+    }
+
+    return sum >> RESAMPLE_SUM_SHIFT;
+}
+
+#if defined(RESAMPLE_SSE2)
+static inline __m128i DivideBy255(const __m128i x) {
+    auto rounded = _mm_add_epi32(x, _mm_set1_epi32(128));
+
+    return _mm_srai_epi32(_mm_add_epi32(rounded, _mm_srai_epi32(rounded, 8)), 8);
+}
+
+static inline __m128i Unpremultiply(const __m128i values) {
+    auto alpha = _mm_shuffle_epi32(values, 0xFF);
+    // Dividing by a zero alpha gives a value cvtps turns into INT_MIN, which the mask clears.
+    auto color = _mm_cvtps_epi32(_mm_div_ps(_mm_cvtepi32_ps(_mm_sub_epi32(_mm_slli_epi32(values, 8), values)),
+        _mm_cvtepi32_ps(alpha)));
+    auto alphaLane = _mm_set_epi32(-1, 0, 0, 0);
+
+    color = _mm_and_si128(color, _mm_cmpgt_epi32(alpha, _mm_setzero_si128()));
+
+    return _mm_or_si128(_mm_andnot_si128(alphaLane, color), _mm_and_si128(alphaLane, DivideBy255(values)));
+}
+#elif defined(RESAMPLE_NEON)
+static inline int32x4_t DivideBy255(const int32x4_t x) {
+    auto rounded = vaddq_s32(x, vdupq_n_s32(128));
+
+    return vshrq_n_s32(vaddq_s32(rounded, vshrq_n_s32(rounded, 8)), 8);
+}
+
+static inline int32x4_t Unpremultiply(const int32x4_t values) {
+    auto alpha = vdupq_laneq_s32(values, 3);
+    auto color = vcvtnq_s32_f32(vdivq_f32(vcvtq_f32_s32(vmulq_n_s32(values, 255)), vcvtq_f32_s32(alpha)));
+    const uint32_t alphaLane[4] = { 0, 0, 0, 0xFFFFFFFF };
+
+    color = vandq_s32(color, vreinterpretq_s32_u32(vcgtq_s32(alpha, vdupq_n_s32(0))));
+
+    return vbslq_s32(vld1q_u32(alphaLane), DivideBy255(values), color);
+}
+#endif
+
+// Sums count horizontally resampled rows, an even number, into a row of output. Values pass out through saturating
+// packs, which clamp the same as the portable loop.
+static void ResampleColumns(const int16_t *const *rows, const int16_t *weights, const int count, const size_t length,
+        const bool unpremultiply, unsigned char *output) {
+    size_t i = 0;
+
+#if defined(RESAMPLE_SSE2)
+    for (; i + 8 <= length; i += 8) {
+        auto lo = _mm_set1_epi32(RESAMPLE_SUM_ROUND);
+        auto hi = lo;
+
+        for (int k = 0; k < count; k += 2) {
+            auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k] + i));
+            auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k + 1] + i));
+            int32_t weightPair;
+
+            memcpy(&weightPair, weights + k, 4);
+
+            auto pair = _mm_set1_epi32(weightPair);
+
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), pair));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), pair));
+        }
+
+        lo = _mm_srai_epi32(lo, RESAMPLE_SUM_SHIFT);
+        hi = _mm_srai_epi32(hi, RESAMPLE_SUM_SHIFT);
+
+        if (unpremultiply) {
+            lo = Unpremultiply(lo);
+            hi = Unpremultiply(hi);
+        } else {
+            lo = DivideBy255(lo);
+            hi = DivideBy255(hi);
+        }
+
+        auto packed = _mm_packs_epi32(lo, hi);
+
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(output + i), _mm_packus_epi16(packed, packed));
+    }
+#elif defined(RESAMPLE_NEON)
+    for (; i + 8 <= length; i += 8) {
+        auto lo = vdupq_n_s32(RESAMPLE_SUM_ROUND);
+        auto hi = lo;
+
+        for (int k = 0; k < count; k++) {
+            auto row = vld1q_s16(rows[k] + i);
+
+            lo = vmlal_n_s16(lo, vget_low_s16(row), weights[k]);
+            hi = vmlal_high_n_s16(hi, row, weights[k]);
+        }
+
+        lo = vshrq_n_s32(lo, RESAMPLE_SUM_SHIFT);
+        hi = vshrq_n_s32(hi, RESAMPLE_SUM_SHIFT);
+
+        if (unpremultiply) {
+            lo = Unpremultiply(lo);
+            hi = Unpremultiply(hi);
+        } else {
+            lo = DivideBy255(lo);
+            hi = DivideBy255(hi);
+        }
+
+        vst1_u8(output + i, vqmovun_s16(vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi))));
+    }
+#endif
+
+    for (; i < length; i += 4) {
+        int32_t values[4];
+
+        for (int c = 0; c < 4; c++) {
+            values[c] = ColumnSum(rows, weights, count, i + c);
+        }
+
+        WritePixel(values, unpremultiply, output + i);
+    }
+}
+
+void ResampleRGBA8(const unsigned char *pixels, const size_t stride, unsigned char *output, const size_t outputStride,
+        const ResampleAxis& horizontal, const ResampleAxis& vertical, const ResampleAlpha alpha, void *scratch) {
+    // Weighted sums are premultiplied colors, in the same scale as alpha, so writing them out as they are leaves the
+    // output premultiplied.
+    auto alphaWeighted = alpha != RESAMPLE_ALPHA_NONE;
+    auto unpremultiply = alpha == RESAMPLE_ALPHA_WEIGHTED;
+    auto inputWidth = horizontal.GetInputSize();
+    auto rowLength = (size_t)horizontal.GetOutputSize()*4;
+    auto taps = vertical.GetTaps();
+    // The rows and weights of the nonzero taps of an output row.
+    auto columnRows = static_cast<const int16_t **>(scratch);
+    auto ringRows = reinterpret_cast<int *>(columnRows + taps + 1);
+    auto columnWeights = reinterpret_cast<int16_t *>(ringRows + taps);
+    // Horizontally resampled rows, kept while the vertical pass still needs them. Input row n lives in slot n % taps.
+    auto ring = columnWeights + taps + 1;
+    auto expanded = ring + rowLength*taps;
+
+    std::fill(ringRows, ringRows + taps, -1);
+    std::fill(expanded + (size_t)inputWidth*4, expanded + ((size_t)inputWidth + 1)*4, 0);
+
+    for (int y = 0; y < vertical.GetOutputSize(); y++, output += outputStride) {
+        auto first = vertical.GetFirst(y);
+        auto weights = vertical.GetWeights(y);
+        auto count = 0;
+
+        for (int k = 0; k < taps; k++) {
+            auto weight = weights[k];
+
+            if (weight == 0) {
+                continue;
+            }
+
+            auto n = first + k;
+            auto slot = n % taps;
+            auto row = ring + rowLength*slot;
+
+            if (ringRows[slot] != n) {
+                ExpandRow(pixels + (size_t)n*stride, inputWidth, alphaWeighted, expanded);
+                ResampleRow(expanded, horizontal, row);
+                ringRows[slot] = n;
+            }
+
+            columnRows[count] = row;
+            columnWeights[count] = weight;
+            count++;
+        }
+
+        if (count % 2 != 0) {
+            columnRows[count] = columnRows[0];
+            columnWeights[count] = 0;
+            count++;
+        }
+
+        ResampleColumns(columnRows, columnWeights, count, rowLength, unpremultiply, output);
+    }
+}
+
+// Averages the block of pixels p, in the order top left, top right, bottom left, bottom right.
+static inline void HalveBlock(const unsigned char *const *p, const ResampleAlpha alpha, unsigned char *dest) {
+    auto weight = p[0][3] + p[1][3] + p[2][3] + p[3][3];
+
+    if (alpha == RESAMPLE_ALPHA_NONE) {
+        for (int c = 0; c < 3; c++) {
+            dest[c] = (unsigned char)((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) >> 2);
+        }
+    } else {
+        // Dividing the weighted colors by four opaque pixels' worth of alpha leaves them premultiplied. A fully
+        // transparent block has nothing to weigh, and comes out black, without branching on it.
+        auto divisor = alpha == RESAMPLE_ALPHA_PREMULTIPLY ? 4*255 : weight + (weight == 0);
+
+        for (int c = 0; c < 3; c++) {
+            dest[c] = (unsigned char)((p[0][c]*p[0][3] + p[1][c]*p[1][3] + p[2][c]*p[2][3] + p[3][c]*p[3][3]
+                + divisor/2) / divisor);
+        }
+    }
+
+    dest[3] = (unsigned char)((weight + 2) >> 2);
+}
+
+// Blocks of opaque pixels weigh every color by 255, so any alpha treatment comes down to the plain average, which the
+// vector paths compute for two blocks at a time from four pixels of each row.
+#if defined(RESAMPLE_SSE2)
+static inline bool IsOpaque(const unsigned char *top, const unsigned char *bottom) {
+    auto both = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(top)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom)));
+    auto alpha = _mm_or_si128(both, _mm_set1_epi32(0x00FFFFFF));
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(alpha, _mm_set1_epi32(-1))) == 0xFFFF;
+}
+
+static inline void HalvePair(const unsigned char *top, const unsigned char *bottom, unsigned char *dest) {
+    auto zero = _mm_setzero_si128();
+    auto t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(top));
+    auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom));
+    auto left = _mm_add_epi16(_mm_unpacklo_epi8(t, zero), _mm_unpacklo_epi8(b, zero));
+    auto right = _mm_add_epi16(_mm_unpackhi_epi8(t, zero), _mm_unpackhi_epi8(b, zero));
+
+    left = _mm_add_epi16(left, _mm_srli_si128(left, 8));
+    right = _mm_add_epi16(right, _mm_srli_si128(right, 8));
+
+    auto average = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(left, right), _mm_set1_epi16(2)), 2);
+
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dest), _mm_packus_epi16(average, average));
+}
+#elif defined(RESAMPLE_NEON)
+static inline bool IsOpaque(const unsigned char *top, const unsigned char *bottom) {
+    auto both = vreinterpretq_u32_u8(vandq_u8(vld1q_u8(top), vld1q_u8(bottom)));
+
+    return vminvq_u32(vorrq_u32(both, vdupq_n_u32(0x00FFFFFF))) == 0xFFFFFFFF;
+}
+
+static inline void HalvePair(const unsigned char *top, const unsigned char *bottom, unsigned char *dest) {
+    auto t = vld1q_u8(top);
+    auto b = vld1q_u8(bottom);
+    auto left = vaddl_u8(vget_low_u8(t), vget_low_u8(b));
+    auto right = vaddl_u8(vget_high_u8(t), vget_high_u8(b));
+    auto sums = vcombine_u16(vadd_u16(vget_low_u16(left), vget_high_u16(left)),
+        vadd_u16(vget_low_u16(right), vget_high_u16(right)));
+
+    vst1_u8(dest, vrshrn_n_u16(sums, 2));
+}
+#endif
+
+void HalveRGBA8(const unsigned char *pixels, const int width, const int height, const size_t stride,
+        unsigned char *output, const size_t outputStride, const ResampleAlpha alpha) {
+    auto outputWidth = (width + 1)/2;
+    auto outputHeight = (height + 1)/2;
+
+    for (int y = 0; y < outputHeight; y++, output += outputStride) {
+        auto top = pixels + (size_t)(2*y)*stride;
+        auto bottom = 2*y + 1 < height ? top + stride : top;
+        auto dest = output;
+        auto x = 0;
+
+#if defined(RESAMPLE_SSE2) || defined(RESAMPLE_NEON)
+        for (; x + 2 <= width/2; x += 2, dest += 8) {
+            auto left = (size_t)(8*x);
+
+            if (alpha == RESAMPLE_ALPHA_NONE || IsOpaque(top + left, bottom + left)) {
+                HalvePair(top + left, bottom + left, dest);
+            } else {
+                const unsigned char *first[4] = { top + left, top + left + 4, bottom + left, bottom + left + 4 };
+                const unsigned char *second[4] = { top + left + 8, top + left + 12, bottom + left + 8,
+                    bottom + left + 12 };
+
+                HalveBlock(first, alpha, dest);
+                HalveBlock(second, alpha, dest + 4);
+            }
+        }
+#endif
+
+        for (; x < outputWidth; x++, dest += 4) {
+            auto left = (size_t)(8*x);
+            auto right = 2*x + 1 < width ? left + 4 : left;
+            const unsigned char *p[4] = { top + left, top + right, bottom + left, bottom + right };
+
+            HalveBlock(p, alpha, dest);
+        }
+    }
+}
+
+static int NearestIndex(const int i, const float start, const float length, const int count, const int size) {
+    return std::min(std::max((int)floorf(start + ((float)i + 0.5f)*length/(float)count), 0), size - 1);
+}
+
+void NearestRGBA8(const unsigned char *pixels, const int width, const int height, const size_t stride,
+        unsigned char *output, const int outputWidth, const int outputHeight, const size_t outputStride, const float left,
+        const float top, const float right, const float bottom) {
+    auto factorX = outputWidth / width;
+    auto factorY = outputHeight / height;
+    auto replicate = left == 0 && top == 0 && right == width && bottom == height && factorX > 0 && factorY > 0
+        && outputWidth == factorX*width && outputHeight == factorY*height;
+    auto rowSize = (size_t)outputWidth*4;
+    std::vector<int> columns;
+    auto previous = -1;
+
+    if (!replicate) {
+        columns.resize(outputWidth);
+
+        for (int x = 0; x < outputWidth; x++) {
+            columns[x] = NearestIndex(x, left, right - left, outputWidth, width)*4;
+        }
+    }
+
+    for (int y = 0; y < outputHeight; y++, output += outputStride) {
+        auto sourceY = replicate ? y / factorY : NearestIndex(y, top, bottom - top, outputHeight, height);
+
+        // Rows sampling the same input row are copies of the one before.
+        if (sourceY == previous) {
+            memcpy(output, output - outputStride, rowSize);
+            continue;
+        }
+
+        auto row = pixels + (size_t)sourceY*stride;
+        auto dest = output;
+
+        if (replicate) {
+            for (int x = 0; x < width; x++) {
+                uint32_t pixel;
+                auto k = 0;
+
+                memcpy(&pixel, row + (size_t)x*4, 4);
+
+                // Copies go out two pixels to a store.
+                uint64_t pair = ((uint64_t)pixel << 32) | pixel;
+
+                for (; k + 2 <= factorX; k += 2, dest += 8) {
+                    memcpy(dest, &pair, 8);
+                }
+
+                if (k < factorX) {
+                    memcpy(dest, &pixel, 4);
+                    dest += 4;
+                }
+            }
+        } else {
+            for (int x = 0; x < outputWidth; x++, dest += 4) {
+                memcpy(dest, row + columns[x], 4);
+            }
+        }
+
+        previous = sourceY;
+    }
+}
+
+#if defined(RESAMPLE_SSE2)
+// Multiplies four 16 bit pixels by their alpha and divides by 255 as DivideBy255() does, which stays within 16 bits.
+static inline __m128i Premultiply(const __m128i pixels) {
+    auto alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, 0xFF), 0xFF);
+    auto rounded = _mm_add_epi16(_mm_mullo_epi16(pixels, alpha), _mm_set1_epi16(128));
+
+    return _mm_srli_epi16(_mm_add_epi16(rounded, _mm_srli_epi16(rounded, 8)), 8);
+}
+#elif defined(RESAMPLE_NEON)
+static inline uint8x8_t Premultiply(const uint8x8_t color, const uint8x8_t alpha) {
+    auto rounded = vaddq_u16(vmull_u8(color, alpha), vdupq_n_u16(128));
+
+    return vshrn_n_u16(vaddq_u16(rounded, vshrq_n_u16(rounded, 8)), 8);
+}
+#endif
+
+void PremultiplyRGBA8(const unsigned char *pixels, const int width, const int height, const size_t stride,
+        unsigned char *output, const size_t outputStride) {
+    for (int y = 0; y < height; y++, pixels += stride, output += outputStride) {
+        auto source = pixels;
+        auto dest = output;
+        auto x = 0;
+
+#if defined(RESAMPLE_SSE2)
+        auto zero = _mm_setzero_si128();
+        auto alphaMask = _mm_set1_epi32((int)0xFF000000);
+
+        for (; x + 4 <= width; x += 4, source += 16, dest += 16) {
+            auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source));
+            auto colors = _mm_packus_epi16(Premultiply(_mm_unpacklo_epi8(v, zero)),
+                Premultiply(_mm_unpackhi_epi8(v, zero)));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest),
+                _mm_or_si128(_mm_andnot_si128(alphaMask, colors), _mm_and_si128(alphaMask, v)));
+        }
+#elif defined(RESAMPLE_NEON)
+        for (; x + 8 <= width; x += 8, source += 32, dest += 32) {
+            auto v = vld4_u8(source);
+
+            v.val[0] = Premultiply(v.val[0], v.val[3]);
+            v.val[1] = Premultiply(v.val[1], v.val[3]);
+            v.val[2] = Premultiply(v.val[2], v.val[3]);
+            vst4_u8(dest, v);
+        }
+#endif
+
+        for (; x < width; x++, source += 4, dest += 4) {
+            auto alpha = source[3];
+
+            dest[0] = (unsigned char)DivideBy255(source[0]*alpha);
+            dest[1] = (unsigned char)DivideBy255(source[1]*alpha);
+            dest[2] = (unsigned char)DivideBy255(source[2]*alpha);
+            dest[3] = alpha;
+        }
+    }
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Weights are 16 bit fixed point numbers with this many fractional bits, so they range from -2 to 2.
+#define RESAMPLE_WEIGHT_BITS 14
+
+// The weights of one axis of a resize, gathered per output pixel. Output pixel i is the sum of GetTaps() input pixels,
+// starting at GetFirst(i), each multiplied by its weight. The weights of every output pixel add up to exactly
+// 1 << RESAMPLE_WEIGHT_BITS, so flat areas stay flat.
+class ResampleAxis {
+    private:
+        int inputSize;
+        int outputSize;
+        int taps;
+        // Weights of each output pixel, padded with a zero weight to an even count, so they can be read in pairs.
+        int stride;
+        std::vector<int> first;
+        std::vector<int16_t> weights;
+
+    public:
+        // first holds outputSize input pixel indexes and weights holds taps weights for each output pixel. Every tap
+        // must lie inside the input.
+        ResampleAxis(const int inputSize, const int outputSize, const int taps, const int *first, const float *weights);
+
+        int GetInputSize() const {
+            return this->inputSize;
+        }
+
+        int GetOutputSize() const {
+            return this->outputSize;
+        }
+
+        int GetTaps() const {
+            return this->taps;
+        }
+
+        int GetFirst(const int output) const {
+            return this->first[output];
+        }
+
+        // GetTaps() weights, followed by a zero when there is an odd number of them.
+        const int16_t *GetWeights(const int output) const {
+            return this->weights.data() + (size_t)output*this->stride;
+        }
+};
+
+// Bytes of working memory ResampleRGBA8() needs for a resize along these axes.
+size_t ResampleScratchSize(const ResampleAxis& horizontal, const ResampleAxis& vertical);
+
+// How ResampleRGBA8() treats the alpha channel, the last byte of each pixel.
+enum ResampleAlpha {
+    // Every channel is filtered on its own, which is right for opaque or premultiplied pixels.
+    RESAMPLE_ALPHA_NONE,
+    // Colors are weighted by alpha while filtering, so transparent pixels do not bleed into their neighbours.
+    RESAMPLE_ALPHA_WEIGHTED,
+    // As weighted, but the output is left premultiplied.
+    RESAMPLE_ALPHA_PREMULTIPLY
+};
+
+// Resizes 8 bit, 4 channel pixels with 16 bit weights and integer arithmetic, in SSE2 or NEON where available. Every
+// platform computes the same result. It is within 1 of a float resize with the same weights, except for the colors of
+// nearly transparent pixels when unpremultiplying, whose alpha weighted sums only keep about 14 bits.
+void ResampleRGBA8(const unsigned char *pixels, const size_t stride, unsigned char *output, const size_t outputStride,
+    const ResampleAxis& horizontal, const ResampleAxis& vertical, const ResampleAlpha alpha, void *scratch);
+
+// Multiplies the colors of 4 channel pixels by their alpha. output may be pixels, to premultiply in place.
+void PremultiplyRGBA8(const unsigned char *pixels, const int width, const int height, const size_t stride,
+    unsigned char *output, const size_t outputStride);
+
+// Halves 8 bit, 4 channel pixels with a 2x2 box filter, treating alpha as ResampleRGBA8() does. The output is
+// (width + 1) / 2 by (height + 1) / 2 pixels. An odd last row or column is averaged with itself.
+void HalveRGBA8(const unsigned char *pixels, const int width, const int height, const size_t stride,
+    unsigned char *output, const size_t outputStride, const ResampleAlpha alpha);
+
+// Resizes 4 channel pixels by copying the pixel nearest to the center of each output pixel. The region of the input
+// from (left, top) to (right, bottom) fills the output. Scaling the whole image up by whole factors replicates pixels
+// without sampling.
+void NearestRGBA8(const unsigned char *pixels, const int width, const int height, const size_t stride,
+    unsigned char *output, const int outputWidth, const int outputHeight, const size_t outputStride, const float left,
+    const float top, const float right, const float bottom);
+
+#endif
@@ -6,12 +6,16 @@
  */
  
 #include "Threads.h"
+#include <mutex>
 
 using namespace Napi;
 
 int GetInitialThreadPoolSize();
 
+// One pool serves every environment (main thread and worker threads) in the process. push() is thread safe, but
+// resizing is not, so size changes from different environments are serialized.
 ctpl::thread_pool sThreadPool(GetInitialThreadPoolSize());
+std::mutex sThreadPoolMutex;
 
 ctpl::thread_pool& GetThreadPool() {
     return sThreadPool;
@@ -23,10 +27,14 @@ int GetInitialThreadPoolSize() {
 }
 
 Value GetThreadPoolSize(const CallbackInfo& info) {
+    std::lock_guard<std::mutex> lock(sThreadPoolMutex);
+
     return Number::New(info.Env(), sThreadPool.size());
 }
 
 void SetThreadPoolSize(const CallbackInfo& info) {
     auto size = info[0].As<Number>().Int32Value();
+    std::lock_guard<std::mutex> lock(sThreadPoolMutex);
+
     sThreadPool.resize(size);
 }
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+'use strict';
+
+const chai = require('chai');
+chai.use(require('chai-as-promised'));
+const assert = chai.assert;
+const Pipeline = require('../lib');
+
+const TEST_PNG = 'test/resources/one.png';
+const TEST_BMP = 'test/resources/one.bmp';
+const TEST_TALL = 'test/resources/tall.png';
+const TEST_WIDE = 'test/resources/wide.png';
+
+describe("atlas module test", () => {
+    describe("atlas()", () => {
+        it("should draw every image onto a page", () => {
+            const sources = [TEST_TALL, TEST_WIDE, TEST_PNG, TEST_BMP];
+
+            return Pipeline.atlas(sources, {padding: 2}).then(atlas => {
+                assert.lengthOf(atlas.pages, 1);
+                assert.lengthOf(atlas.frames, sources.length);
+                sources.forEach((source, i) => assertFrame(atlas, i, Pipeline(source).bytes().toBufferSync()));
+                assertSeparate(atlas.frames, 2);
+            });
+        });
+        it("should open more pages when images do not fit on one", () => {
+            return Pipeline.atlas([TEST_TALL, TEST_WIDE, TEST_TALL, TEST_WIDE], {maxSize: 200}).then(atlas => {
+                assert.isAbove(atlas.pages.length, 1);
+                atlas.pages.forEach(page => {
+                    assert.isAtMost(page.header.width, 200);
+                    assert.isAtMost(page.header.height, 200);
+                });
+                assertSeparate(atlas.frames, 0);
+            });
+        });
+        it("should trim transparent borders", () => {
+            const padded = Pipeline(TEST_WIDE).bytes().pad().resize(100, 100);
+            const pixels = padded.toBufferSync();
+
+            return Pipeline.atlas([padded], {trim: true}).then(atlas => {
+                const frame = atlas.frames[0];
+                const bounds = alphaBounds(pixels, 100, 100);
+
+                assert.deepInclude(frame, {x: 0, y: 0, u0: 0, v0: 0, u1: 1, v1: 1, sourceWidth: 100, sourceHeight: 100});
+                assert.deepInclude(frame, {trimX: bounds.left, trimY: bounds.top});
+                assert.deepInclude(frame, {width: bounds.right - bounds.left, height: bounds.bottom - bounds.top});
+            });
+        });
+        it("should output pages in the requested pixel format", () => {
+            return Pipeline.atlas([TEST_PNG], {format: 'rgba'}).then(atlas => {
+                assert.equal(atlas.pages[0].header.format, 'rgba');
+                assert.equal(atlas.pages[0].readUInt32LE(0), 0x0B151FFF);
+            });
+        });
+        it("should reject when an image is larger than a page", () => {
+            return assert.isRejected(Pipeline.atlas([TEST_PNG, TEST_TALL], {maxSize: 100}));
+        });
+        it("should reject when an image fails to load", () => {
+            return assert.isRejected(Pipeline.atlas([TEST_PNG, 'doesnotexist.jpg']));
+        });
+        it("should throw Error for invalid sources", () => {
+            assert.throws(() => Pipeline.atlas([]));
+            assert.throws(() => Pipeline.atlas(TEST_PNG));
+            assert.throws(() => Pipeline.atlas([4]));
+            assert.throws(() => Pipeline.atlas([Pipeline(TEST_PNG).bytes({shared: true})]));
+            assert.throws(() => Pipeline.atlas([Pipeline(TEST_PNG).tensor()]));
+        });
+        it("should throw Error for invalid options", () => {
+            [{maxSize: 0}, {maxSize: 1.5}, {padding: -1}, {trim: 'yes'}, {format: 'rgbx'}].forEach(options => {
+                assert.throws(() => Pipeline.atlas([TEST_PNG], options));
+            });
+        });
+    });
+    describe("atlasSync()", () => {
+        it("should draw every image onto a page", () => {
+            const atlas = Pipeline.atlasSync([TEST_WIDE, Pipeline(TEST_TALL).bytes().resize(10, 10)]);
+
+            assert.lengthOf(atlas.frames, 2);
+            assertFrame(atlas, 0, Pipeline(TEST_WIDE).bytes().toBufferSync());
+            assertFrame(atlas, 1, Pipeline(TEST_TALL).bytes().resize(10, 10).toBufferSync());
+        });
+        it("should throw Error when an image fails to load", () => {
+            assert.throws(() => Pipeline.atlasSync([TEST_PNG, 'doesnotexist.jpg']));
+        });
+    });
+});
+
+function assertFrame(atlas, index, expected) {
+    const frame = atlas.frames[index];
+    const page = atlas.pages[frame.page];
+    const pageWidth = page.header.width;
+
+    assert.deepInclude(frame, {width: expected.header.width, height: expected.header.height});
+    assert.closeTo(frame.u0, frame.x / pageWidth, 1e-9);
+    assert.closeTo(frame.v1, (frame.y + frame.height) / page.header.height, 1e-9);
+
+    for (let y = 0; y < frame.height; y++) {
+        const start = ((frame.y + y)*pageWidth + frame.x)*4;
+        const row = page.slice(start, start + frame.width*4);
+
+        assert.isTrue(row.equals(expected.slice(y*frame.width*4, (y + 1)*frame.width*4)));
+    }
+}
+
+function assertSeparate(frames, padding) {
+    frames.forEach((a, i) => frames.slice(i + 1).forEach(b => {
+        assert.isFalse(a.page === b.page && a.x < b.x + b.width + padding && b.x < a.x + a.width + padding
+            && a.y < b.y + b.height + padding && b.y < a.y + a.height + padding);
+    }));
+}
+
+function alphaBounds(pixels, width, height) {
+    const bounds = {left: width, top: height, right: 0, bottom: 0};
+
+    for (let y = 0; y < height; y++) {
+        for (let x = 0; x < width; x++) {
+            if (pixels[(y*width + x)*4 + 3] !== 0) {
+                bounds.left = Math.min(bounds.left, x);
+                bounds.top = Math.min(bounds.top, y);
+                bounds.right = Math.max(bounds.right, x + 1);
+                bounds.bottom = Math.max(bounds.bottom, y + 1);
+            }
+        }
+    }
+
+    return bounds;
+}
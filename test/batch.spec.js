@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+'use strict';
+
+const chai = require('chai');
+chai.use(require('chai-as-promised'));
+const assert = chai.assert;
+const Pipeline = require('../lib');
+
+const TEST_PNG = 'test/resources/one.png';
+const TEST_BMP = 'test/resources/one.bmp';
+const TEST_TALL = 'test/resources/tall.png';
+const TEST_WIDE = 'test/resources/wide.png';
+
+describe("batch module test", () => {
+    describe("toBatch()", () => {
+        it("should output all images into one buffer", () => {
+            return Pipeline.toBatch([
+                Pipeline(TEST_TALL).bytes({format: 'rgba'}).cover().resize(8, 8),
+                Pipeline(TEST_WIDE).bytes({format: 'rgba'}).cover().resize(8, 8),
+                Pipeline(TEST_TALL).bytes({format: 'rgba'}).crop(0, 0, 20, 20).resize(8, 8),
+            ]).then(batch => {
+                const single = Pipeline(TEST_TALL).bytes({format: 'rgba'}).crop(0, 0, 20, 20).resize(8, 8).toBufferSync();
+
+                assert.deepInclude(batch.header, {width: 8, height: 8, channels: 4, format: 'rgba'});
+                assert.deepEqual(batch.header.offsets, [0, 256, 512]);
+                assert.equal(batch.length, 768);
+                assert.isTrue(batch.slice(512).equals(single));
+            });
+        });
+        it("should reject when output sizes differ", () => {
+            return assert.isRejected(Pipeline.toBatch([Pipeline(TEST_PNG).bytes(), Pipeline(TEST_TALL).bytes()]));
+        });
+        it("should reject when an image fails to load", () => {
+            return assert.isRejected(Pipeline.toBatch([Pipeline(TEST_PNG).bytes(), Pipeline('doesnotexist.jpg').bytes()]));
+        });
+        it("should throw Error for invalid pipelines", () => {
+            assert.throws(() => Pipeline.toBatch([]));
+            assert.throws(() => Pipeline.toBatch([TEST_PNG]));
+            assert.throws(() => Pipeline.toBatch([Pipeline(TEST_PNG).bytes({shared: true})]));
+            assert.throws(() => Pipeline.toBatch([Pipeline(TEST_PNG).tensor()]));
+            assert.throws(() => Pipeline.toBatch([Pipeline(TEST_PNG).bytes({format: 'rgba'}), Pipeline(TEST_BMP).bytes({format: 'argb'})]));
+        });
+    });
+    describe("toBatchSync()", () => {
+        it("should output all images into one buffer", () => {
+            const batch = Pipeline.toBatchSync([
+                Pipeline(TEST_PNG).bytes({format: 'rgba'}),
+                Pipeline(TEST_BMP).bytes({format: 'rgba'}),
+            ]);
+
+            assert.deepEqual(batch.header.offsets, [0, 4]);
+            assert.equal(batch.readUInt32LE(0), 0x0B151FFF);
+            assert.equal(batch.readUInt32LE(4), 0x0B151FFF);
+        });
+        it("should throw Error when output sizes differ", () => {
+            assert.throws(() => Pipeline.toBatchSync([Pipeline(TEST_PNG).bytes(), Pipeline(TEST_WIDE).bytes()]));
+        });
+    });
+});
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+'use strict';
+
+const chai = require('chai');
+chai.use(require('chai-as-promised'));
+const assert = chai.assert;
+const Pipeline = require('../lib');
+
+const TEST_PNG = 'test/resources/one.png';
+const TEST_TALL = 'test/resources/tall.png';
+const TEST_WIDE = 'test/resources/wide.png';
+
+describe("compile module test", () => {
+    describe("compile()", () => {
+        it("should throw Error for invalid options", () => {
+            assert.throws(() => Pipeline.compile({toBuffer: true}));
+            assert.throws(() => Pipeline.compile({resize: [0, 10]}));
+            assert.throws(() => Pipeline.compile({cover: 'up'}));
+        });
+        it("should match the uncompiled pipeline", () => {
+            const compiled = Pipeline.compile({bytes: {format: 'argb'}, cover: 'north', resize: [10, 10], filter: 'box'});
+
+            [TEST_TALL, TEST_WIDE].forEach(source => {
+                const expected = Pipeline(source).bytes({format: 'argb'}).cover('north').resize(10, 10).filter('box').toBufferSync();
+                const buffer = compiled.runSync(source);
+
+                assert.deepEqual(buffer.header, expected.header);
+                assert.isTrue(buffer.equals(expected));
+            });
+        });
+        it("should run asynchronously for many sources", () => {
+            const compiled = Pipeline.compile({bytes: {format: 'rgba'}, crop: [0, 0, 20, 20], resize: [4, 4]});
+
+            return Promise.all([TEST_TALL, TEST_WIDE, TEST_TALL].map(source => compiled.run(source))).then(buffers => {
+                buffers.forEach(buffer => assert.include(buffer.header, {width: 4, height: 4, format: 'rgba'}));
+            });
+        });
+        it("should write to a target", () => {
+            const target = new Uint8Array(8);
+
+            Pipeline.compile({bytes: {format: 'rgba'}}).runSync(TEST_PNG, {target, offset: 4});
+
+            assert.equal(Buffer.from(target.buffer).readUInt32LE(4), 0x0B151FFF);
+        });
+        it("should reject when file not found", () => {
+            return assert.isRejected(Pipeline.compile({}).run('doesnotexist.jpg'), Error, 'File not found.');
+        });
+        it("should throw Error for invalid source", () => {
+            assert.throws(() => Pipeline.compile({}).runSync(''));
+            assert.throws(() => Pipeline.compile({}).run(4));
+        });
+    });
+    describe("runAll()", () => {
+        it("should resolve results in input order", () => {
+            const sources = [TEST_TALL, 'doesnotexist.jpg', TEST_WIDE, TEST_PNG];
+
+            return Pipeline.compile({bytes: {format: 'rgba'}}).runAll(sources).then(results => {
+                assert.lengthOf(results, sources.length);
+                assert.include(results[0].header, {width: 20, height: 200, index: 0});
+                assert.instanceOf(results[1], Error);
+                assert.equal(results[1].message, 'File not found.');
+                assert.equal(results[1].index, 1);
+                assert.include(results[2].header, {width: 200, height: 20, index: 2});
+                assert.include(results[3].header, {width: 1, height: 1, index: 3});
+            });
+        });
+        it("should resolve every result in completion order", () => {
+            const sources = [TEST_TALL, 'doesnotexist.jpg', TEST_WIDE, TEST_PNG];
+
+            return Pipeline.compile({resize: [4, 4]}).runAll(sources, {order: 'completion'}).then(results => {
+                assert.lengthOf(results, sources.length);
+                assert.sameMembers(results.map(result => result.header ? result.header.index : result.index), [0, 1, 2, 3]);
+            });
+        });
+        it("should resolve shared outputs for every source", () => {
+            const sources = [TEST_TALL, TEST_WIDE, TEST_PNG];
+
+            return Pipeline.compile({bytes: {format: 'rgba', shared: true}}).runAll(sources).then(results => {
+                results.forEach((result, i) => {
+                    const expected = Pipeline(sources[i]).bytes({format: 'rgba'}).toBufferSync();
+
+                    assert.instanceOf(result, Uint8Array);
+                    assert.instanceOf(result.buffer, SharedArrayBuffer);
+                    assert.include(result.header, {width: expected.header.width, height: expected.header.height, index: i});
+                    assert.isTrue(expected.equals(result));
+                });
+            });
+        });
+        it("should resolve an empty array for no sources", () => {
+            return Pipeline.compile({}).runAll([]).then(results => assert.deepEqual(results, []));
+        });
+        it("should throw Error for invalid arguments", () => {
+            assert.throws(() => Pipeline.compile({}).runAll(TEST_PNG));
+            assert.throws(() => Pipeline.compile({}).runAll([TEST_PNG, null]));
+            assert.throws(() => Pipeline.compile({}).runAll([TEST_PNG], {order: 'random'}));
+        });
+        it("should throw Error for output to a given SharedArrayBuffer", () => {
+            const compiled = Pipeline.compile({bytes: {format: 'rgba', shared: new SharedArrayBuffer(16)}});
+
+            assert.throws(() => compiled.runAll([TEST_PNG]), /SharedArrayBuffer/);
+        });
+    });
+});
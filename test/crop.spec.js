@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+'use strict';
+
+const chai = require('chai');
+chai.use(require('chai-as-promised'));
+const assert = chai.assert;
+const Pipeline = require('../lib');
+
+const TEST_SVG = 'test/resources/rounded-rect.svg';
+const TEST_TALL = 'test/resources/tall.png';
+// 48x48, each pixel (x*5, y*5, (x*7 + y*3) & 255, 255).
+const TEST_GRADIENTS = ['test/resources/gradient.png', 'test/resources/gradient.bmp', 'test/resources/gradient.tga'];
+
+describe("crop module test", () => {
+    describe("crop()", () => {
+        it("should output only the crop region", () => {
+            const full = Pipeline(TEST_TALL).bytes().toBufferSync();
+            const buffer = Pipeline(TEST_TALL)
+                .bytes()
+                .crop(5, 50, 10, 20)
+                .toBufferSync();
+
+            assert.equal(buffer.header.width, 10);
+            assert.equal(buffer.header.height, 20);
+
+            for (let y = 0; y < 20; y++) {
+                const row = (50 + y)*20*4 + 5*4;
+
+                assert.isTrue(buffer.slice(y*10*4, (y + 1)*10*4).equals(full.slice(row, row + 10*4)));
+            }
+        });
+        it("should output the crop region of every row order", () => {
+            TEST_GRADIENTS.forEach(source => {
+                [[0, 0, 48, 1], [3, 10, 20, 15], [7, 47, 30, 1], [0, 20, 48, 28]].forEach(([x, y, width, height]) => {
+                    assertGradient(Pipeline(source).bytes({format: 'rgba'}).crop(x, y, width, height).toBufferSync(),
+                        x, y, width, height);
+                    assertGradient(Pipeline(source).bytes({format: 'rgba'}).crop(x, y, width, height)
+                        .toBuffersSync([{width, height}])[0], x, y, width, height);
+                });
+            });
+        });
+        it("should output different crop regions of a file loaded at the same time", () => {
+            const regions = [[0, 0, 48, 10], [0, 30, 48, 18], [5, 0, 10, 48]];
+
+            return Promise.all(regions.map(([x, y, width, height]) => Pipeline(TEST_GRADIENTS[0])
+                .bytes({format: 'rgba'}).crop(x, y, width, height).toBuffer()))
+                .then(buffers => buffers.forEach((buffer, i) => assertGradient(buffer, ...regions[i])));
+        });
+        it("should resize the crop region", () => {
+            return Pipeline(TEST_TALL)
+                .bytes()
+                .crop(0, 0, 20, 20)
+                .resize(10, 10)
+                .toBuffer()
+                .then(buffer => {
+                    assert.equal(buffer.header.width, 10);
+                    assert.equal(buffer.header.height, 10);
+                });
+        });
+        it("should rasterize only the crop region of an SVG", () => {
+            [false, true].forEach(disableDecoderScaling => {
+                const buffer = Pipeline(TEST_SVG)
+                    .bytes()
+                    .filter('gaussian', { disableDecoderScaling })
+                    .crop(50, 0, 50, 25)
+                    .resize(100, 50)
+                    .toBufferSync();
+
+                assert.equal(buffer.header.width, 100);
+                assert.equal(buffer.header.height, 50);
+            });
+        });
+        it("should reject when the crop region is outside of the image", () => {
+            return assert.isRejected(Pipeline(TEST_TALL).bytes().crop(10, 0, 20, 20).toBuffer());
+        });
+        it("should throw Error for invalid arguments", () => {
+            [[-1, 0, 1, 1], [0, 0.5, 1, 1], [0, 0, 0, 1], [0, 0, 1]]
+                .forEach(args => assert.throws(() => Pipeline(TEST_TALL).crop(...args)));
+        });
+    });
+});
+
+function assertGradient(buffer, left, top, width, height) {
+    assert.equal(buffer.header.width, width);
+    assert.equal(buffer.header.height, height);
+
+    for (let y = 0; y < height; y++) {
+        for (let x = 0; x < width; x++) {
+            const i = (y*width + x)*4;
+            const sx = left + x;
+            const sy = top + y;
+
+            assert.deepEqual([...buffer.slice(i, i + 4)], [sx*5, sy*5, (sx*7 + sy*3) & 255, 255]);
+        }
+    }
+}
@@ -23,6 +23,52 @@ describe("format module test", () => {
         it("should throw Error for invalid pixel format", () => {
             [null, '', 4, 'rgbx'].forEach(format => assert.throws(() => Pipeline(FOUR_CHANNEL_IMAGE).bytes({format})));
         });
+        it("should accept valid shared options", () => {
+            [true, false, new SharedArrayBuffer(4)].forEach(shared => Pipeline(FOUR_CHANNEL_IMAGE).bytes({shared}));
+        });
+        it("should throw Error for invalid shared option", () => {
+            [null, 1, 'yes', new ArrayBuffer(4)].forEach(shared => assert.throws(() => Pipeline(FOUR_CHANNEL_IMAGE).bytes({shared})));
+        });
+        it("should throw Error for invalid premultiplied option", () => {
+            [null, 1, 'yes'].forEach(premultiplied => assert.throws(() => Pipeline(FOUR_CHANNEL_IMAGE).bytes({premultiplied})));
+        });
+        it("should leave opaque pixels unchanged when premultiplied", () => {
+            const straight = Pipeline(FOUR_CHANNEL_IMAGE).bytes({format: 'rgba'}).toBufferSync();
+            const premultiplied = Pipeline(FOUR_CHANNEL_IMAGE).bytes({format: 'rgba', premultiplied: true}).toBufferSync();
+
+            assert.isTrue(straight.equals(premultiplied));
+        });
+        it("should premultiply translucent pixels", () => {
+            [undefined, 'fixed'].forEach(engine => ['tent', 'nearest'].forEach(filter => {
+                const buffer = Pipeline('test/resources/rounded-rect.svg')
+                    .bytes({format: 'rgba', premultiplied: true})
+                    .filter(filter, {disableDecoderScaling: true, engine})
+                    .resize(16, 16)
+                    .toBufferSync();
+
+                for (let i = 0; i < buffer.length; i += 4) {
+                    assert.isAtMost(Math.max(buffer[i], buffer[i + 1], buffer[i + 2]), buffer[i + 3]);
+                }
+            }));
+        });
+        it("should premultiply to exact values", () => {
+            // 2x2 blocks: opaque, alphas 128, 0, 255 and 129, and fully transparent.
+            const source = 'test/resources/halve.png';
+            const copied = Pipeline(source).bytes({format: 'rgba', premultiplied: true}).toBufferSync();
+            const expected = [70, 80, 90, 255, 38, 13, 63, 128, 0, 0, 0, 0];
+
+            assert.deepEqual([...copied.slice(8, 12)], [100, 0, 0, 128]);
+            assert.deepEqual([...copied.slice(36, 40)], [51, 51, 51, 129]);
+
+            ['exact', 'fast'].forEach(strategy => {
+                const pipeline = () => Pipeline(source)
+                    .bytes({format: 'rgba', premultiplied: true})
+                    .filter('box', {strategy});
+
+                assert.deepEqual([...pipeline().resize(3, 1).toBufferSync()], expected);
+                assert.deepEqual([...pipeline().toBuffersSync([{width: 3, height: 1}])[0]], expected);
+            });
+        });
         describe("with four channel source image", () => {
             it("should produce rgba pixels", () => {
                 pixelFormatTest(FOUR_CHANNEL_IMAGE, 'rgba', 0x0B151FFF, 0xFF1F150B);
@@ -37,6 +83,14 @@ describe("format module test", () => {
                 pixelFormatTest(FOUR_CHANNEL_IMAGE, 'bgra', 0x1F150BFF, 0xFF0B151F);
             });
         });
+        it("should decode simultaneous loads of one file in their own pixel formats", () => {
+            const formats = ['rgba', 'argb', 'rgba', 'bgra', 'keep'];
+
+            return Promise.all(formats.map(format => Pipeline(FOUR_CHANNEL_IMAGE).bytes({format}).toBuffer()))
+                .then(buffers => buffers.forEach((buffer, i) => {
+                    assert.isTrue(buffer.equals(Pipeline(FOUR_CHANNEL_IMAGE).bytes({format: formats[i]}).toBufferSync()));
+                }));
+        });
         describe("with three channel source image", () => {
             it("should produce rgba pixels", () => {
                 pixelFormatTest(THREE_CHANNEL_IMAGE, 'rgba', 0x0B151FFF, 0xFF1F150B);
@@ -52,6 +106,60 @@ describe("format module test", () => {
             });
         });
     });
+    describe("tensor()", () => {
+        it("should throw Error for invalid options", () => {
+            assert.throws(() => Pipeline(FOUR_CHANNEL_IMAGE).tensor({layout: 'chw'}));
+            assert.throws(() => Pipeline(FOUR_CHANNEL_IMAGE).tensor({dtype: 'float16'}));
+            assert.throws(() => Pipeline(FOUR_CHANNEL_IMAGE).tensor({mean: [0, 0]}));
+            assert.throws(() => Pipeline(FOUR_CHANNEL_IMAGE).tensor({std: [1, 0, 1]}));
+        });
+        it("should produce a normalized float32 tensor", () => {
+            const tensor = Pipeline(FOUR_CHANNEL_IMAGE).tensor({mean: [0.5, 0.5, 0.5], std: [0.5, 0.5, 0.5]}).toBufferSync();
+
+            assert.instanceOf(tensor, Float32Array);
+            assert.deepInclude(tensor.header, {width: 1, height: 1, channels: 3, layout: 'nchw', dtype: 'float32'});
+            assert.closeTo(tensor[0], 0x0B / 127.5 - 1, 1e-5);
+            assert.closeTo(tensor[1], 0x15 / 127.5 - 1, 1e-5);
+            assert.closeTo(tensor[2], 0x1F / 127.5 - 1, 1e-5);
+        });
+        it("should produce planar channels for nchw", () => {
+            return Pipeline(FOUR_CHANNEL_IMAGE).resize(2, 2).tensor({dtype: 'uint8'}).toBuffer()
+                .then(tensor => {
+                    assert.equal(tensor.length, 12);
+                    assert.deepEqual(Array.from(tensor), [
+                        0x0B, 0x0B, 0x0B, 0x0B, 0x15, 0x15, 0x15, 0x15, 0x1F, 0x1F, 0x1F, 0x1F]);
+                });
+        });
+        it("should produce interleaved channels for nhwc", () => {
+            const tensor = Pipeline(THREE_CHANNEL_IMAGE).tensor({layout: 'nhwc', dtype: 'uint8'}).toBufferSync();
+
+            assert.deepEqual(Array.from(tensor), [0x0B, 0x15, 0x1F]);
+        });
+        it("should write a batch into one target", () => {
+            const batch = new Float32Array(6);
+
+            Pipeline(FOUR_CHANNEL_IMAGE).tensor().toBufferSync({target: batch, index: 1});
+
+            assert.deepEqual(Array.from(batch.subarray(0, 3)), [0, 0, 0]);
+            assert.closeTo(batch[3], 0x0B / 255, 1e-5);
+            assert.closeTo(batch[5], 0x1F / 255, 1e-5);
+        });
+        it("should write floats at an unaligned target offset", () => {
+            const target = Buffer.alloc(13);
+
+            Pipeline(FOUR_CHANNEL_IMAGE).tensor().toBufferSync({target, offset: 1});
+
+            assert.equal(target[0], 0);
+            assert.closeTo(target.readFloatLE(1), 0x0B / 255, 1e-5);
+            assert.closeTo(target.readFloatLE(9), 0x1F / 255, 1e-5);
+        });
+        it("should throw Error for a target stride", () => {
+            assert.throws(() => Pipeline(FOUR_CHANNEL_IMAGE).tensor().toBufferSync({target: new Float32Array(3), stride: 12}));
+        });
+        it("should throw Error for multiple sizes", () => {
+            assert.throws(() => Pipeline(FOUR_CHANNEL_IMAGE).tensor().toBuffers([{width: 1, height: 1}]));
+        });
+    });
 });
 
 function pixelFormatTest(filename, format, pixelLE, pixelBE) {
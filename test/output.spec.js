@@ -10,12 +10,14 @@
 const chai = require('chai');
 chai.use(require('chai-as-promised'));
 const assert = chai.assert;
+const { Worker } = require('worker_threads');
 const Pipeline = require('../lib');
 
 const FILE_NOT_FOUND_FILENAME = 'doesnotexist.jpg';
 const TEST_RESOURCES_DIR = 'test/resources';
 const TEST_IMAGES = [ 'one.bmp', 'one.gif', 'one.jpg', 'one.png', 'one.psd', 'one.tga', 'one.hdr', 'one.ppm', 'one.pgm' ];
 const TEST_SVG = TEST_RESOURCES_DIR + '/rounded-rect.svg';
+const TEST_ANIMATED_GIF = TEST_RESOURCES_DIR + '/animated.gif';
 
 describe('output module test', () => {
     describe('toBuffer()', () => {
@@ -36,6 +38,45 @@ describe('output module test', () => {
                 .bytes()
                 .toBuffer());
         });
+        it('should resolve a burst of concurrent loads', () => {
+            const count = 200;
+            const loads = [];
+
+            for (let i = 0; i < count; i++) {
+                loads.push(Pipeline(`${TEST_RESOURCES_DIR}/${TEST_IMAGES[i % TEST_IMAGES.length]}`).bytes().toBuffer());
+            }
+
+            return Promise.all(loads).then(buffers => {
+                assert.lengthOf(buffers, count);
+                buffers.forEach(checkBuffer);
+            });
+        });
+        it('should give identical concurrent loads buffers of their own', () => {
+            const load = () => Pipeline(`${TEST_RESOURCES_DIR}/tall.png`).bytes({format: 'rgba'}).resize(10, 100).toBuffer();
+
+            return Promise.all([load(), load(), load()]).then(([first, second, third]) => {
+                const expected = Buffer.from(first);
+
+                assert.notStrictEqual(first, second);
+                assert.deepEqual(first.header, second.header);
+                first.release();
+                second.release();
+                assert.isTrue(third.equals(expected));
+            });
+        });
+        it('should resize concurrent loads of one source to their own sizes', () => {
+            const sizes = [[20, 200], [10, 100], [5, 50], [2, 20]];
+            const load = ([width, height]) => Pipeline(`${TEST_RESOURCES_DIR}/tall.png`).bytes().resize(width, height);
+
+            return Promise.all(sizes.map(size => load(size).toBuffer())).then(buffers => {
+                buffers.forEach((buffer, i) => assert.isTrue(buffer.equals(load(sizes[i]).toBufferSync())));
+            });
+        });
+        it('should reject with an Error', () => {
+            return assert.isRejected(Pipeline(FILE_NOT_FOUND_FILENAME)
+                .bytes()
+                .toBuffer(), Error, 'File not found.');
+        });
         it('should load SVG', () => {
             return assert.isFulfilled(Pipeline(TEST_SVG)
                 .bytes()
@@ -48,6 +89,182 @@ describe('output module test', () => {
                 .toBuffer());
         });
     });
+    describe('shared output', () => {
+        it('should output to a new SharedArrayBuffer', () => {
+            return Pipeline(TEST_SVG)
+                .bytes({shared: true})
+                .toBuffer()
+                .then(view => {
+                    assert.instanceOf(view, Uint8Array);
+                    assert.instanceOf(view.buffer, SharedArrayBuffer);
+                    checkSvgBuffer(view);
+                });
+        });
+        it('should output to a caller supplied SharedArrayBuffer', () => {
+            const shared = new SharedArrayBuffer(4);
+
+            return Pipeline(`${TEST_RESOURCES_DIR}/one.png`)
+                .bytes({format: 'rgba', shared})
+                .toBuffer()
+                .then(view => {
+                    assert.strictEqual(view.buffer, shared);
+                    checkBufferHeader(view.header);
+                    assert.equal(new DataView(shared).getUint32(0, true), 0x0B151FFF);
+                });
+        });
+        it('should reject when the SharedArrayBuffer is too small', () => {
+            return assert.isRejected(Pipeline(TEST_SVG).bytes({shared: new SharedArrayBuffer(4)}).toBuffer());
+        });
+        it('should output to a new SharedArrayBuffer synchronously', () => {
+            const view = Pipeline(TEST_SVG).bytes({shared: true}).toBufferSync();
+
+            assert.instanceOf(view.buffer, SharedArrayBuffer);
+            checkSvgBuffer(view);
+        });
+    });
+    describe('target output', () => {
+        it('should write into a Buffer at an offset', () => {
+            const target = Buffer.alloc(16, 0xAB);
+
+            return Pipeline(`${TEST_RESOURCES_DIR}/one.png`)
+                .bytes({format: 'rgba'})
+                .toBuffer({target, offset: 8})
+                .then(view => {
+                    assert.strictEqual(view.buffer, target.buffer);
+                    assert.equal(view.header.offset, 8);
+                    assert.equal(view.header.stride, 4);
+                    assert.equal(target.readUInt32LE(4), 0xABABABAB);
+                    assert.equal(target.readUInt32LE(8), 0x0B151FFF);
+                    assert.equal(target.readUInt32LE(12), 0xABABABAB);
+                });
+        });
+        it('should write rows at the given stride', () => {
+            const stride = 64;
+            const target = Buffer.alloc(4 + stride*10, 0xAB);
+            const view = Pipeline(TEST_SVG)
+                .bytes()
+                .resize(10, 10)
+                .toBufferSync({target, offset: 4, stride});
+
+            assert.equal(view.header.width, 10);
+            assert.equal(view.header.height, 10);
+            assert.equal(view.header.stride, stride);
+
+            for (let y = 0; y < 9; y++) {
+                // padding between the end of one row and the start of the next is untouched
+                assert.equal(target.readUInt32LE(4 + y*stride + 40), 0xABABABAB);
+            }
+        });
+        it('should reject when the target is too small', () => {
+            return assert.isRejected(Pipeline(TEST_SVG).bytes().toBuffer({target: Buffer.alloc(100*100*4), offset: 1}));
+        });
+        it('should reject when the stride is smaller than a row', () => {
+            return assert.isRejected(Pipeline(TEST_SVG).bytes().toBuffer({target: Buffer.alloc(100*100*4*2), stride: 4}));
+        });
+        it('should throw Error for invalid options', () => {
+            [{target: 'buffer'}, {target: Buffer.alloc(4), offset: -1}, {target: Buffer.alloc(4), stride: 0.5}]
+                .forEach(options => assert.throws(() => Pipeline(TEST_SVG).bytes().toBuffer(options)));
+        });
+    });
+    describe('toBuffers()', () => {
+        const sizes = [{width: 10, height: 10}, {width: 40, height: 40, format: 'argb'}, {width: 20, height: 20}];
+
+        it('should output every size in request order', () => {
+            return Pipeline(TEST_SVG)
+                .bytes({format: 'rgba'})
+                .toBuffers(sizes)
+                .then(buffers => checkSizes(buffers, sizes));
+        });
+        it('should output every size of a raster image', () => {
+            return Pipeline(`${TEST_RESOURCES_DIR}/tall.png`)
+                .bytes({format: 'rgba'})
+                .toBuffers(sizes, {cascade: true})
+                .then(buffers => {
+                    assert.lengthOf(buffers, sizes.length);
+                    assert.deepEqual(buffers.map(b => [b.header.width, b.header.height]), [[1, 10], [4, 40], [2, 20]]);
+                });
+        });
+        it('should reject when file not found', () => {
+            return assert.isRejected(Pipeline(FILE_NOT_FOUND_FILENAME).bytes().toBuffers(sizes), Error, 'File not found.');
+        });
+        it('should throw Error for invalid sizes', () => {
+            [undefined, [], [{width: 0, height: 1}], [{width: 1}], [{width: 1, height: 1, format: 'xyz'}]]
+                .forEach(invalid => assert.throws(() => Pipeline(TEST_SVG).bytes().toBuffers(invalid)));
+        });
+    });
+    describe('toBuffersSync()', () => {
+        it('should output every size in request order', () => {
+            const sizes = [{width: 10, height: 10}, {width: 40, height: 40}];
+
+            checkSizes(Pipeline(TEST_SVG).bytes({format: 'rgba'}).toBuffersSync(sizes), sizes);
+        });
+    });
+    describe('toFrames()', () => {
+        it('should deliver every frame of an animated GIF in order', () => {
+            const frames = [];
+
+            return Pipeline(TEST_ANIMATED_GIF)
+                .bytes({format: 'rgba'})
+                .toFrames(frame => frames.push(frame))
+                .then(header => {
+                    assert.equal(header.frames, 3);
+                    assert.equal(header.width, 4);
+                    assert.equal(header.height, 4);
+                    checkFrames(frames);
+                });
+        });
+        it('should resize every frame', () => {
+            const frames = [];
+
+            return Pipeline(TEST_ANIMATED_GIF)
+                .bytes()
+                .resize(2, 2)
+                .toFrames(frame => frames.push(frame))
+                .then(header => {
+                    assert.equal(header.frames, 3);
+                    frames.forEach(frame => {
+                        assert.equal(frame.header.width, 2);
+                        assert.equal(frame.header.height, 2);
+                        assert.lengthOf(frame, 2*2*4);
+                    });
+                });
+        });
+        it('should deliver a still image as one frame', () => {
+            const frames = [];
+
+            return Pipeline(`${TEST_RESOURCES_DIR}/one.png`)
+                .bytes()
+                .toFrames(frame => frames.push(frame))
+                .then(header => {
+                    assert.equal(header.frames, 1);
+                    assert.lengthOf(frames, 1);
+                    checkBuffer(frames[0]);
+                });
+        });
+        it('should reject with the error thrown by the frame callback', () => {
+            return assert.isRejected(Pipeline(TEST_ANIMATED_GIF)
+                .bytes()
+                .toFrames(() => { throw Error('stop'); }), Error, 'stop');
+        });
+        it('should reject for SVG', () => {
+            return assert.isRejected(Pipeline(TEST_SVG).bytes().toFrames(() => {}));
+        });
+        it('should throw Error for invalid options', () => {
+            assert.throws(() => Pipeline(TEST_ANIMATED_GIF).bytes().toFrames());
+            assert.throws(() => Pipeline(TEST_ANIMATED_GIF).bytes({shared: true}).toFrames(() => {}));
+        });
+    });
+    describe('toFramesSync()', () => {
+        it('should deliver every frame of an animated GIF in order', () => {
+            const frames = [];
+            const header = Pipeline(TEST_ANIMATED_GIF)
+                .bytes({format: 'rgba'})
+                .toFramesSync(frame => frames.push(frame));
+
+            assert.equal(header.frames, 3);
+            checkFrames(frames);
+        });
+    });
     describe('toBufferSync()', () => {
         it('should load all supported image formats', () => {
             TEST_IMAGES.map(image => Pipeline(`${TEST_RESOURCES_DIR}/${image}`).bytes().toBufferSync())
@@ -83,6 +300,29 @@ describe('output module test', () => {
                 .then(checkSvgHeader);
         });
     });
+    describe('worker threads', () => {
+        it('should load images in several worker threads at once', () => {
+            const source = `
+                const { parentPort, workerData } = require('worker_threads');
+                const Pipeline = require(workerData.lib);
+
+                Pipeline(workerData.image).bytes().toBuffer()
+                    .then(buffer => parentPort.postMessage(buffer.header))
+                    .catch(e => parentPort.postMessage(e.message));
+            `;
+            const workers = [0, 1, 2, 3].map(() => new Promise((resolve, reject) => {
+                const worker = new Worker(source, {
+                    eval: true,
+                    workerData: { lib: require.resolve('../lib'), image: `${process.cwd()}/${TEST_RESOURCES_DIR}/one.png` }
+                });
+
+                worker.once('message', resolve);
+                worker.once('error', reject);
+            }));
+
+            return Promise.all(workers).then(headers => headers.forEach(checkBufferHeader));
+        });
+    });
     describe('toHeaderSync()', () => {
         it('should throw Error when file not found', () => {
             assert.throws(() => Pipeline(FILE_NOT_FOUND_FILENAME).bytes().toHeaderSync());
@@ -103,6 +343,35 @@ function checkHeader(header) {
     assert.equal(header.channels, 4);
 }
 
+function checkSizes(buffers, sizes) {
+    assert.lengthOf(buffers, sizes.length);
+    buffers.forEach((buffer, i) => {
+        assert.equal(buffer.header.width, sizes[i].width);
+        assert.equal(buffer.header.height, sizes[i].height);
+        assert.equal(buffer.header.format, sizes[i].format || 'rgba');
+        assert.lengthOf(buffer, sizes[i].width*sizes[i].height*4);
+    });
+}
+
+function checkFrames(frames) {
+    // red, then green, then blue drawn over the top left quarter of the green frame
+    const expected = [
+        [0xFF0000FF, 0xFF0000FF, 100],
+        [0x00FF00FF, 0x00FF00FF, 200],
+        [0x0000FFFF, 0x00FF00FF, 300],
+    ];
+
+    assert.lengthOf(frames, expected.length);
+    frames.forEach((frame, i) => {
+        assert.equal(frame.header.frame, i);
+        assert.equal(frame.header.delay, expected[i][2]);
+        assert.equal(frame.header.format, 'rgba');
+        assert.lengthOf(frame, 4*4*4);
+        assert.equal(frame.readUInt32LE(0), expected[i][0]);
+        assert.equal(frame.readUInt32LE(frame.length - 4), expected[i][1]);
+    });
+}
+
 function checkSvgHeader(header) {
     assert.equal(header.width, 100);
     assert.equal(header.height, 100);
@@ -16,6 +16,8 @@ const TEST_IMAGE = 'test/resources/one.png';
 const TEST_SVG = 'test/resources/rounded-rect.svg';
 const TEST_TALL = 'test/resources/tall.png';
 const TEST_WIDE = 'test/resources/wide.png';
+const TEST_HALVE = 'test/resources/halve.png';
+const TEST_GRADIENT = 'test/resources/gradient.png';
 
 describe("resize module test", () => {
     describe("resize()", () => {
@@ -90,6 +92,16 @@ describe("resize module test", () => {
             assert.equal(buffer.header.width, 100);
             assert.equal(buffer.header.height, 10);
         });
+        it("should resize a 200x20 to 50x5 with a 100x5 bounding box", () => {
+            ['fit', 'contain'].forEach(constraint => {
+                const buffer = Pipeline(TEST_WIDE)
+                    .bytes()[constraint]()
+                    .resize(100, 5)
+                    .toBufferSync();
+                assert.equal(buffer.header.width, 50);
+                assert.equal(buffer.header.height, 5);
+            });
+        });
         it("should resize a 100x100 to 50x50 with a 50x50 bounding box", () => {
             const buffer = Pipeline(TEST_SVG)
                 .bytes()
@@ -100,6 +112,113 @@ describe("resize module test", () => {
             assert.equal(buffer.header.height, 50);
         });
     });
+    describe("cover()", () => {
+        it("should resize a 20x200 to exactly 50x50", () => {
+            const buffer = Pipeline(TEST_TALL)
+                .bytes()
+                .cover()
+                .resize(50, 50)
+                .toBufferSync();
+            assert.equal(buffer.header.width, 50);
+            assert.equal(buffer.header.height, 50);
+        });
+        it("should resize a 200x20 to exactly 30x60 with every gravity", () => {
+            ['center', 'north', 'south', 'east', 'west', 'northeast', 'northwest', 'southeast', 'southwest'].forEach(gravity => {
+                const buffer = Pipeline(TEST_WIDE)
+                    .bytes()
+                    .cover(gravity)
+                    .resize(30, 60)
+                    .toBufferSync();
+                assert.equal(buffer.header.width, 30);
+                assert.equal(buffer.header.height, 60);
+                assert.lengthOf(buffer, 30*60*4);
+            });
+        });
+        it("should match an explicit crop and resize for every gravity", () => {
+            const factor = (gravity, start, end) => gravity.includes(start) ? 0 : (gravity.includes(end) ? 1 : 0.5);
+            // Cover size and the whole pixel region of the 48x48 gradient that covers it, cropped across and down.
+            const cases = [[32, 16, 48, 24], [16, 32, 24, 48]];
+
+            ['center', 'north', 'south', 'east', 'west', 'northeast', 'northwest', 'southeast', 'southwest'].forEach(gravity => {
+                cases.forEach(([coverWidth, coverHeight, regionWidth, regionHeight]) => {
+                    const x = (48 - regionWidth)*factor(gravity, 'west', 'east');
+                    const y = (48 - regionHeight)*factor(gravity, 'north', 'south');
+                    const covered = Pipeline(TEST_GRADIENT)
+                        .bytes()
+                        .cover(gravity)
+                        .resize(coverWidth, coverHeight)
+                        .toBufferSync();
+                    const cropped = Pipeline(TEST_GRADIENT)
+                        .bytes()
+                        .crop(x, y, regionWidth, regionHeight)
+                        .resize(coverWidth, coverHeight)
+                        .toBufferSync();
+
+                    assert.deepEqual(covered.header, cropped.header);
+                    assert.isTrue(covered.equals(cropped), `${coverWidth}x${coverHeight} ${gravity}`);
+                });
+            });
+        });
+        it("should resize SVG to exactly 80x40", () => {
+            [false, true].forEach(disableDecoderScaling => {
+                const buffer = Pipeline(TEST_SVG)
+                    .bytes()
+                    .filter('gaussian', { disableDecoderScaling })
+                    .cover('south')
+                    .resize(80, 40)
+                    .toBufferSync();
+                assert.equal(buffer.header.width, 80);
+                assert.equal(buffer.header.height, 40);
+            });
+        });
+        it("should throw when gravity arg is invalid", () => {
+            ['', 'up', 5].forEach(input => {
+                assert.throws(() => Pipeline(TEST_IMAGE).cover(input));
+            });
+        });
+    });
+    describe("pad()", () => {
+        it("should letterbox a 200x20 into exactly 100x100", () => {
+            const buffer = Pipeline(TEST_WIDE)
+                .bytes({format: 'rgba'})
+                .pad({background: [255, 0, 0, 255]})
+                .resize(100, 100)
+                .toBufferSync();
+            assert.equal(buffer.header.width, 100);
+            assert.equal(buffer.header.height, 100);
+            // 100x10 image centered, red above and below it
+            assert.equal(buffer.readUInt32LE(0), 0xFF0000FF);
+            assert.equal(buffer.readUInt32LE(buffer.length - 4), 0xFF0000FF);
+        });
+        it("should place a 20x200 by gravity without resizing it", () => {
+            const buffer = Pipeline(TEST_TALL)
+                .bytes({format: 'rgba'})
+                .pad({background: [0, 0, 255, 255], gravity: 'west'})
+                .resize(40, 200)
+                .toBufferSync();
+            assert.equal(buffer.header.width, 40);
+            assert.equal(buffer.header.height, 200);
+            assert.equal(buffer.readUInt32LE(39*4), 0x0000FFFF);
+            assert.equal(buffer.readUInt32LE(20*4), 0x0000FFFF);
+        });
+        it("should pad SVG to exactly 80x40", () => {
+            [false, true].forEach(disableDecoderScaling => {
+                const buffer = Pipeline(TEST_SVG)
+                    .bytes()
+                    .filter('gaussian', { disableDecoderScaling })
+                    .pad()
+                    .resize(80, 40)
+                    .toBufferSync();
+                assert.equal(buffer.header.width, 80);
+                assert.equal(buffer.header.height, 40);
+            });
+        });
+        it("should throw when options are invalid", () => {
+            [{background: [0, 0, 0]}, {background: [0, 0, 0, 256]}, {gravity: 'up'}].forEach(input => {
+                assert.throws(() => Pipeline(TEST_IMAGE).pad(input));
+            });
+        });
+    });
     describe("ignoreAspectRatio()", () => {
         it("should not resize if image is fully inside resize bounding box", () => {
             testContainInside(true);
@@ -147,7 +266,7 @@ describe("resize module test", () => {
     });
     describe("filter()", () => {
         it("should resize with all available filters", () => {
-            ['box', 'tent', 'gaussian'].forEach(filter => {
+            ['box', 'tent', 'gaussian', 'nearest'].forEach(filter => {
                 const buffer = Pipeline(TEST_IMAGE)
                     .bytes()
                     .filter(filter)
@@ -157,6 +276,29 @@ describe("resize module test", () => {
                 assert.equal(buffer.header.height, 2);
             });
         });
+        it("should scale up by whole factors with the nearest filter", () => {
+            const source = Pipeline(TEST_TALL).bytes({format: 'rgba'}).toBufferSync();
+
+            [2, 3].forEach(factor => {
+                const buffer = Pipeline(TEST_TALL)
+                    .bytes({format: 'rgba'})
+                    .filter('nearest')
+                    .resize(20*factor, 200*factor)
+                    .toBufferSync();
+
+                assert.equal(buffer.header.width, 20*factor);
+                assert.equal(buffer.header.height, 200*factor);
+
+                for (let y = 0; y < buffer.header.height; y++) {
+                    for (let x = 0; x < buffer.header.width; x++) {
+                        const i = (y*buffer.header.width + x)*4;
+                        const j = ((y/factor | 0)*20 + (x/factor | 0))*4;
+
+                        assert.deepEqual(buffer.slice(i, i + 4), source.slice(j, j + 4));
+                    }
+                }
+            });
+        });
         it("should resize SVG", () => {
             const buffer = Pipeline(TEST_SVG)
                 .bytes()
@@ -180,6 +322,66 @@ describe("resize module test", () => {
                 assert.throws(() => Pipeline(TEST_IMAGE).filter(input));
             })
         });
+        it("should resize with the fixed engine within 1 of the float engine", () => {
+            [TEST_IMAGE, TEST_TALL, TEST_WIDE].forEach(source => {
+                ['box', 'tent', 'gaussian'].forEach(filter => {
+                    [[7, 5], [300, 90]].forEach(([width, height]) => {
+                        const resize = engine => Pipeline(source)
+                            .bytes({format: 'rgba'})
+                            .filter(filter, {engine})
+                            .resize(width, height)
+                            .toBufferSync();
+                        const float = resize('float');
+                        const fixed = resize('fixed');
+
+                        assert.deepEqual(fixed.header, float.header);
+                        fixed.forEach((value, i) => {
+                            // Colors of fully transparent pixels are not defined.
+                            if (fixed[i - i % 4 + 3] !== 0) {
+                                assert.isAtMost(Math.abs(value - float[i]), 1);
+                            }
+                        });
+                    });
+                });
+            });
+        });
+        it("should resize with the fast strategy", () => {
+            [TEST_IMAGE, TEST_TALL, TEST_WIDE].forEach(source => {
+                const header = Pipeline(source).toHeaderSync();
+
+                [1, 2, 3, 4].forEach(divisor => {
+                    const resize = strategy => Pipeline(source)
+                        .bytes({format: 'rgba'})
+                        .filter('box', {strategy})
+                        .resize(Math.max(1, header.width / divisor | 0), Math.max(1, header.height / divisor | 0))
+                        .toBufferSync();
+                    const exact = resize('exact');
+                    const fast = resize('fast');
+
+                    assert.deepEqual(fast.header, exact.header);
+                    assert.equal(fast.length, exact.length);
+                });
+            });
+
+            // 2x2 blocks: opaque, alphas 128, 0, 255 and 129, and fully transparent.
+            const halved = Pipeline(TEST_HALVE)
+                .bytes({format: 'rgba'})
+                .filter('box', {strategy: 'fast'})
+                .resize(3, 1)
+                .toBufferSync();
+
+            assert.deepEqual([...halved], [70, 80, 90, 255, 75, 25, 125, 128, 0, 0, 0, 0]);
+        });
+        it("should throw when strategy option is invalid", () => {
+            [null, '', 'not a strategy'].forEach(strategy => {
+                assert.throws(() => Pipeline(TEST_IMAGE).filter('box', {strategy}));
+            })
+        });
+        it("should throw when engine option is invalid", () => {
+            [null, '', 'not an engine'].forEach(engine => {
+                assert.throws(() => Pipeline(TEST_IMAGE).filter('box', {engine}));
+            })
+        });
     });
 });
 
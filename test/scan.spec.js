@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2018 Daniel Anderson
+ *
+ * This source code is licensed under the MIT license found in the LICENSE file
+ * in the root directory of this source tree.
+ */
+
+'use strict';
+
+const chai = require('chai');
+chai.use(require('chai-as-promised'));
+const assert = chai.assert;
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const Pipeline = require('../lib');
+
+const TEST_RESOURCES_DIR = 'test/resources';
+
+describe("scan module test", () => {
+    describe("scan()", () => {
+        let dir;
+
+        beforeEach(() => {
+            dir = fs.mkdtempSync(path.join(os.tmpdir(), 'pixels-please-scan-'));
+            fs.mkdirSync(path.join(dir, 'sub'));
+            fs.copyFileSync(`${TEST_RESOURCES_DIR}/one.png`, path.join(dir, 'a.png'));
+            fs.copyFileSync(`${TEST_RESOURCES_DIR}/one.bmp`, path.join(dir, 'b.bmp'));
+            fs.copyFileSync(`${TEST_RESOURCES_DIR}/bad.svg`, path.join(dir, 'c.svg'));
+            fs.copyFileSync(`${TEST_RESOURCES_DIR}/tall.png`, path.join(dir, 'sub', 'd.png'));
+            fs.writeFileSync(path.join(dir, 'notes.txt'), 'not an image');
+        });
+
+        afterEach(() => {
+            fs.unlinkSync(path.join(dir, 'sub', 'd.png'));
+            fs.rmdirSync(path.join(dir, 'sub'));
+            ['a.png', 'b.bmp', 'c.svg', 'notes.txt'].forEach(file => fs.unlinkSync(path.join(dir, file)));
+            fs.rmdirSync(dir);
+        });
+
+        async function collect(iterator) {
+            const results = [];
+
+            for await (const result of iterator) {
+                results.push(result);
+            }
+
+            return results;
+        }
+
+        it("should load the images of a directory", async () => {
+            const results = await collect(Pipeline.scan(dir, {concurrency: 2}));
+            const loaded = results.filter(result => !(result instanceof Error));
+            const failed = results.filter(result => result instanceof Error);
+
+            assert.sameMembers(loaded.map(buffer => path.basename(buffer.header.source)), ['a.png', 'b.bmp']);
+            assert.lengthOf(failed, 1);
+            assert.equal(path.basename(failed[0].source), 'c.svg');
+        });
+        it("should scan subdirectories when recursive", async () => {
+            const results = await collect(Pipeline.scan(dir, {recursive: true, filter: file => file.endsWith('.png')}));
+
+            assert.sameMembers(results.map(buffer => path.basename(buffer.header.source)), ['a.png', 'd.png']);
+        });
+        it("should load with the given pipeline", async () => {
+            const pipeline = Pipeline.compile({bytes: {format: 'rgba'}, resize: [2, 2]});
+            const results = await collect(Pipeline.scan(dir, {pipeline, filter: file => file.endsWith('.png')}));
+
+            assert.lengthOf(results, 1);
+            assert.include(results[0].header, {width: 2, height: 2, format: 'rgba'});
+        });
+        it("should stop when the caller breaks", async () => {
+            let count = 0;
+
+            for await (const result of Pipeline.scan(dir, {recursive: true, concurrency: 1})) {
+                assert.isDefined(result);
+
+                if (++count === 1) {
+                    break;
+                }
+            }
+
+            assert.equal(count, 1);
+        });
+        it("should reject when the directory does not exist", () => {
+            return assert.isRejected(collect(Pipeline.scan(path.join(dir, 'missing'))));
+        });
+        it("should throw Error for invalid options", () => {
+            assert.throws(() => Pipeline.scan(''));
+            assert.throws(() => Pipeline.scan(dir, {concurrency: 0}));
+            assert.throws(() => Pipeline.scan(dir, {filter: '*.png'}));
+            assert.throws(() => Pipeline.scan(dir, {pipeline: Pipeline(dir)}));
+        });
+    });
+});